@@ -0,0 +1,519 @@
+/*
+ o---------------------------------------------------------------------o
+ |
+ | Ndiff benchmark
+ |
+ | Copyright (c) 2012+ laurent.deniau@cern.ch
+ | Gnu General Public License
+ |
+ o---------------------------------------------------------------------o
+
+   Purpose:
+     generate deterministic MAD-X like outputs, references and rules
+     run end-to-end benchmark scenarios and compare with a baseline
+
+   Usage:
+     ndbench gen [options] prefix    -> prefix.out prefix.ref prefix.cfg
+     ndbench run [options] maddiff   -> run all scenarios
+
+ o---------------------------------------------------------------------o
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+
+// ----- constants
+
+#define HEADER  40   // rows of TFS header
+#define SECTION 20   // rows per section for goto rules
+#define MAXREP  100
+#define MAXSCN  32
+
+enum shape { shape_global, shape_perrow, shape_strided, shape_goto, shape_register };
+
+static const char *shape_str[] = { "global", "perrow", "strided", "goto", "register" };
+
+static const char *word_str[] = {
+  "DRIFT", "QUAD", "SBEND", "MARKER", "MONITOR", "KICKER", "RFCAVITY", "SEXT"
+};
+
+// ----- types
+
+struct gen {
+  long   rows;     // number of data rows
+  int    cols;     // number of columns per data row
+  int    width;    // width of each column (line length ~ cols*width)
+  double density;  // fraction of columns holding numbers
+  double perturb;  // fraction of numbers perturbed in the reference
+  int    zip;      // gzip outputs
+  int    shape;    // rules shape
+  unsigned seed;
+};
+
+struct scenario {
+  const char *name;
+  struct gen  gen;
+};
+
+// default scenarios, rows are scaled by -k
+static const struct scenario scenario[] = {
+  { "global"  , { 100000,   8, 18, 1.0, 0.01, 0, shape_global  , 1 } },
+  { "sparse"  , { 100000,   8, 18, 0.5, 0.01, 0, shape_global  , 2 } },
+  { "longline", {   1000, 800, 18, 1.0, 0.01, 0, shape_global  , 3 } },
+  { "perturb" , { 100000,   8, 18, 1.0, 0.50, 0, shape_global  , 4 } },
+  { "perrow"  , { 100000,   8, 18, 1.0, 0.01, 0, shape_perrow  , 5 } },
+  { "strided" , { 100000,   8, 18, 1.0, 0.01, 0, shape_strided , 6 } },
+  { "goto"    , { 100000,   8, 18, 1.0, 0.01, 0, shape_goto    , 7 } },
+  { "register", { 100000,   8, 18, 1.0, 0.01, 0, shape_register, 8 } },
+  { "gzip"    , { 100000,   8, 18, 1.0, 0.01, 1, shape_global  , 9 } },
+};
+
+enum { scenario_n = sizeof scenario / sizeof *scenario };
+
+// ----- private (deterministic generator)
+
+static unsigned long long rnd_state;
+
+static void
+rnd_seed (unsigned seed)
+{
+  rnd_state = 0x9E3779B97F4A7C15ull ^ seed;
+}
+
+static unsigned long long
+rnd_next (void) // xorshift64*
+{
+  rnd_state ^= rnd_state >> 12;
+  rnd_state ^= rnd_state << 25;
+  rnd_state ^= rnd_state >> 27;
+  return rnd_state * 2685821657736338717ull;
+}
+
+static double
+rnd_unif (void)
+{
+  return (rnd_next() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static FILE*
+gen_open (const char *prefix, const char *ext, int zip, char *name)
+{
+  FILE *fp;
+
+  if (zip) {
+    char cmd[FILENAME_MAX+32];
+    sprintf(name, "%s.%s.gz", prefix, ext);
+    sprintf(cmd, "gzip -c > '%s'", name);
+    fp = popen(cmd, "w");
+  } else {
+    sprintf(name, "%s.%s", prefix, ext);
+    fp = fopen(name, "w");
+  }
+
+  if (!fp) {
+    fprintf(stderr, "ndbench: unable to open '%s'\n", name);
+    exit(EXIT_FAILURE);
+  }
+
+  return fp;
+}
+
+static void
+gen_close (FILE *fp, int zip)
+{
+  if (zip) pclose(fp); else fclose(fp);
+}
+
+// precision of the mantissa printed in a column of given width
+static int
+gen_prec (int width)
+{
+  int prec = width - 8;
+  return prec < 3 ? 3 : prec > 16 ? 16 : prec;
+}
+
+// perturb the last digit of the mantissa
+static void
+gen_perturb (char *str)
+{
+  char *e = strchr(str, 'e');
+  if (!e || e == str) return;
+  char *d = e-1;
+  *d = *d < '9' ? *d+1 : *d-1;
+}
+
+static void
+gen_rules (FILE *fp, const struct gen *g)
+{
+  int prec = gen_prec(g->width);
+  long last = HEADER + g->rows;
+
+  fprintf(fp, "# ndbench rules '%s'\n", shape_str[g->shape]);
+  fprintf(fp, "1-4  *  skip  # banner\n");
+
+  switch (g->shape) {
+  case shape_global:
+    fprintf(fp, "*  *  rel=1e-%d\n", prec-1);
+    break;
+
+  case shape_perrow: // one rule per 10 rows, alternating constraints
+    for (long r = HEADER+1; r <= last; r += 10) {
+      fprintf(fp, "%ld-%ld  1    rel=1e-%d\n", r, r+9, prec-1);
+      fprintf(fp, "%ld-%ld  2-$  rel=1e-%d abs=1e-%d\n", r, r+9, prec-1, prec-4);
+    }
+    fprintf(fp, "*  *  rel=1e-%d\n", prec-1);
+    break;
+
+  case shape_strided:
+    for (int s = 1; s <= 4; s++)
+      fprintf(fp, "%d-$/4  %d-$/2  rel=1e-%d\n", HEADER+s, 1 + (s&1), prec-1);
+    fprintf(fp, "*  *  rel=1e-%d abs=1e-%d\n", prec-1, prec-4);
+    break;
+
+  case shape_goto: // skip the junk rows at the start of each section
+    fprintf(fp, "%d-$/%d  *  goto='SECTION'\n", HEADER+1, SECTION);
+    fprintf(fp, "*  *  rel=1e-%d\n", prec-1);
+    break;
+
+  case shape_register:
+    fprintf(fp, "%d-$  *  rel=1e-%d R10=R1 R11=R10+R2 R12=R11*R10 R13=R12-R11 R14=R13/R12\n",
+                HEADER+1, prec-1);
+    fprintf(fp, "*  *  rel=1e-%d\n", prec-1);
+    break;
+  }
+}
+
+// generate prefix.out, prefix.ref and prefix.cfg, return the size of the data
+static void
+gen_files (const char *prefix, const struct gen *g, long *bytes, long *numbers)
+{
+  char out_n[FILENAME_MAX+8], ref_n[FILENAME_MAX+8], cfg_n[FILENAME_MAX+8];
+  FILE *out = gen_open(prefix, "out", g->zip, out_n);
+  FILE *ref = gen_open(prefix, "ref", g->zip, ref_n);
+  FILE *cfg = gen_open(prefix, "cfg", 0, cfg_n);
+  int   prec = gen_prec(g->width);
+  long  nb = 0, nn = 0;
+  char  buf[64], buf2[64];
+
+  rnd_seed(g->seed);
+
+  // banner (skipped)
+  nb += fprintf(out, "ndbench output generated on %ld\n", (long)time(0));
+  nb += fprintf(out, "shape %s rows %ld cols %d\n\n\n", shape_str[g->shape], g->rows, g->cols);
+        fprintf(ref, "ndbench reference generated on %ld\n", 0L);
+        fprintf(ref, "shape %s rows %ld cols %d\n\n\n", shape_str[g->shape], g->rows, g->cols);
+
+  // TFS header
+  for (int r = 5; r <= HEADER; r++) {
+    int n;
+    if (r < HEADER-1)
+      n = sprintf(buf, "@ PARAM%02d %%le %.*e\n", r, prec, 100*rnd_unif()), nn++;
+    else if (r == HEADER-1)
+      n = sprintf(buf, "* NAME S BETX BETY\n");
+    else
+      n = sprintf(buf, "$ %%s %%le %%le %%le\n");
+    fputs(buf, out); fputs(buf, ref); nb += n;
+  }
+
+  // data rows
+  for (long r = 1; r <= g->rows; r++) {
+    long pos = (r-1) % SECTION;
+
+    // junk rows of goto sections differ between files
+    if (g->shape == shape_goto && pos < SECTION/2) {
+      nb += fprintf(out, " iteration %ld residual %.6e\n", r, rnd_unif());
+            fprintf(ref, " iteration %ld residual %.6e\n", r+1, rnd_unif());
+      continue;
+    }
+    if (g->shape == shape_goto && pos == SECTION/2) {
+      nb += fprintf(out, " SECTION %ld\n", r/SECTION);
+            fprintf(ref, " SECTION %ld\n", r/SECTION);
+      continue;
+    }
+
+    nb += fprintf(out, " \"E%08ld\"", r);
+          fprintf(ref, " \"E%08ld\"", r);
+
+    for (int c = 1; c <= g->cols; c++) {
+      if (rnd_unif() < g->density) {
+        double x = (rnd_unif()*2-1) * pow(10, (int)(rnd_unif()*7)-3);
+        sprintf(buf, "%.*e", prec, x);
+        strcpy(buf2, buf);
+        if (rnd_unif() < g->perturb) gen_perturb(buf2);
+        nn++;
+      } else {
+        strcpy(buf, word_str[rnd_next() % 8]);
+        strcpy(buf2, buf);
+      }
+      nb += fprintf(out, " %*s", g->width, buf);
+            fprintf(ref, " %*s", g->width, buf2);
+    }
+
+    nb += fprintf(out, "\n");
+          fprintf(ref, "\n");
+  }
+
+  gen_rules(cfg, g);
+
+  gen_close(out, g->zip);
+  gen_close(ref, g->zip);
+  gen_close(cfg, 0);
+
+  *bytes = 2*nb, *numbers = nn;
+}
+
+// ----- private (runner)
+
+struct result {
+  const char *name;
+  double mbs_best, mbs_med, nps_med;
+  double base;
+};
+
+static double
+now (void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int
+cmp_dbl (const void *a, const void *b)
+{
+  double x = *(const double*)a, y = *(const double*)b;
+  return (x > y) - (x < y);
+}
+
+// run maddiff once on prefix.{out,ref,cfg}, return wall time or -1
+static double
+run_once (const char *cmd, const char *prefix, int zip)
+{
+  char out_n[FILENAME_MAX+8], ref_n[FILENAME_MAX+8], cfg_n[FILENAME_MAX+8];
+  const char *z = zip ? ".gz" : "";
+  sprintf(out_n, "%s.out%s", prefix, z);
+  sprintf(ref_n, "%s.ref%s", prefix, z);
+  sprintf(cfg_n, "%s.cfg"  , prefix);
+
+  double t0 = now();
+  pid_t pid = fork();
+
+  if (pid < 0) return -1;
+  if (pid == 0) {
+    int fd = open("/dev/null", O_WRONLY);
+    if (fd >= 0) { dup2(fd, 1); dup2(fd, 2); }
+    execlp(cmd, cmd, "--quiet", out_n, ref_n, cfg_n, (char*)0);
+    _exit(127);
+  }
+
+  int status;
+  if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status))
+    return -1;
+
+  return now() - t0;
+}
+
+static double
+base_find (const char *file, const char *name)
+{
+  FILE *fp = file ? fopen(file, "r") : 0;
+  char  buf[256], key[64];
+  double mbs, val = 0;
+
+  if (!fp) return 0;
+
+  while (fgets(buf, sizeof buf, fp))
+    if (*buf != '#' && sscanf(buf, "%63s %lf", key, &mbs) == 2 && !strcmp(key, name))
+      val = mbs;
+
+  fclose(fp);
+  return val;
+}
+
+static void
+base_save (const char *file, const struct result *res, int n, int reps, double scale)
+{
+  FILE *fp = fopen(file, "w");
+
+  if (!fp) {
+    fprintf(stderr, "ndbench: unable to write baseline '%s'\n", file);
+    exit(EXIT_FAILURE);
+  }
+
+  fprintf(fp, "# ndbench baseline (median MB/s, numbers/s), reps=%d scale=%g\n", reps, scale);
+  fprintf(fp, "# regenerate with: ndbench run -u -b <this file> <maddiff>\n");
+  for (int i = 0; i < n; i++)
+    fprintf(fp, "%-10s %10.2f %12.4g\n", res[i].name, res[i].mbs_med, res[i].nps_med);
+
+  fclose(fp);
+}
+
+// ----- usage
+
+static void
+usage (void)
+{
+  fprintf(stderr,
+    "usage:\n"
+    "  ndbench gen [options] prefix      generate prefix.out, prefix.ref, prefix.cfg\n"
+    "    -n rows    number of data rows (default 100000)\n"
+    "    -c cols    number of columns per row (default 8)\n"
+    "    -w width   width of columns (default 18)\n"
+    "    -d frac    density of numbers among columns (default 1)\n"
+    "    -p frac    rate of perturbed numbers in reference (default 0.01)\n"
+    "    -z         compress outputs with gzip\n"
+    "    -r shape   rules shape: global, perrow, strided, goto, register\n"
+    "    -s seed    random seed (default 1)\n"
+    "  ndbench run [options] maddiff     run all scenarios\n"
+    "    -b file    baseline file to compare with (or to update)\n"
+    "    -u         update the baseline file with the results\n"
+    "    -k scale   scale the number of rows of scenarios (default 1)\n"
+    "    -r reps    repetitions per scenario (default 5)\n"
+    "    -t frac    tolerated slowdown before reporting a regression (default 0.1)\n"
+    "    -o dir     directory for the generated files (default .)\n"
+    "    -x name    run only the named scenario (can be repeated)\n");
+  exit(EXIT_FAILURE);
+}
+
+static int
+shape_find (const char *str)
+{
+  for (int i = 0; i < (int)(sizeof shape_str / sizeof *shape_str); i++)
+    if (!strcmp(str, shape_str[i])) return i;
+
+  fprintf(stderr, "ndbench: invalid rules shape '%s'\n", str);
+  exit(EXIT_FAILURE);
+}
+
+// ----- commands
+
+static int
+cmd_gen (int argc, char *argv[])
+{
+  struct gen g = { 100000, 8, 18, 1.0, 0.01, 0, shape_global, 1 };
+  int i;
+
+  for (i = 2; i < argc-1 && argv[i][0] == '-'; i++) {
+    switch (argv[i][1]) {
+    case 'n': g.rows    = atol(argv[++i]);           break;
+    case 'c': g.cols    = atoi(argv[++i]);           break;
+    case 'w': g.width   = atoi(argv[++i]);           break;
+    case 'd': g.density = atof(argv[++i]);           break;
+    case 'p': g.perturb = atof(argv[++i]);           break;
+    case 'r': g.shape   = shape_find(argv[++i]);     break;
+    case 's': g.seed    = strtoul(argv[++i], 0, 10); break;
+    case 'z': g.zip     = 1;                         break;
+    default : usage();
+    }
+  }
+
+  if (i != argc-1 || g.rows < 1 || g.cols < 1 || g.width < 8) usage();
+
+  long bytes, numbers;
+  gen_files(argv[i], &g, &bytes, &numbers);
+  printf("%s: %ld bytes, %ld numbers per file\n", argv[i], bytes/2, numbers);
+  return EXIT_SUCCESS;
+}
+
+static int
+cmd_run (int argc, char *argv[])
+{
+  const char *base = 0, *dir = ".", *only[MAXSCN];
+  int reps = 5, update = 0, only_n = 0, regress = 0, n = 0, i;
+  double scale = 1, tol = 0.1;
+  struct result res[scenario_n];
+
+  for (i = 2; i < argc-1 && argv[i][0] == '-'; i++) {
+    switch (argv[i][1]) {
+    case 'b': base  = argv[++i];       break;
+    case 'u': update = 1;              break;
+    case 'k': scale = atof(argv[++i]); break;
+    case 'r': reps  = atoi(argv[++i]); break;
+    case 't': tol   = atof(argv[++i]); break;
+    case 'o': dir   = argv[++i];       break;
+    case 'x': if (only_n < MAXSCN) only[only_n++] = argv[++i]; break;
+    default : usage();
+    }
+  }
+
+  if (i != argc-1 || reps < 1 || reps > MAXREP || !(scale > 0) || (update && !base)) usage();
+
+  const char *cmd = argv[i];
+
+  printf("%-10s %10s %10s %12s %10s %7s\n",
+         "scenario", "MB/s@min", "MB/s@med", "numbers/s", "baseline", "ratio");
+
+  for (int s = 0; s < scenario_n; s++) {
+    const struct scenario *scn = scenario+s;
+    char   prefix[FILENAME_MAX];
+    double t[MAXREP];
+    long   bytes, numbers;
+    int    j;
+
+    if (only_n) {
+      for (j = 0; j < only_n && strcmp(only[j], scn->name); j++) ;
+      if (j == only_n) continue;
+    }
+
+    struct gen g = scn->gen;
+    g.rows = g.rows * scale < 1 ? 1 : g.rows * scale;
+    sprintf(prefix, "%.*s/ndbench-%s", FILENAME_MAX-32, dir, scn->name);
+    gen_files(prefix, &g, &bytes, &numbers);
+
+    run_once(cmd, prefix, g.zip); // warmup (page cache)
+
+    for (j = 0; j < reps; j++) {
+      if ((t[j] = run_once(cmd, prefix, g.zip)) < 0) {
+        fprintf(stderr, "ndbench: '%s' failed on scenario '%s'\n", cmd, scn->name);
+        return EXIT_FAILURE;
+      }
+    }
+
+    qsort(t, reps, sizeof *t, cmp_dbl);
+    double med = reps & 1 ? t[reps/2] : (t[reps/2-1] + t[reps/2]) / 2;
+
+    struct result *r = res + n++;
+    r->name     = scn->name;
+    r->mbs_best = bytes * 1e-6 / t[0];
+    r->mbs_med  = bytes * 1e-6 / med;
+    r->nps_med  = 2 * numbers / med;
+    r->base     = update ? 0 : base_find(base, scn->name);
+
+    double ratio = r->base > 0 ? r->mbs_med / r->base : 0;
+    int    slow  = r->base > 0 && ratio < 1 - tol;
+    regress += slow;
+
+    printf("%-10s %10.2f %10.2f %12.4g ", r->name, r->mbs_best, r->mbs_med, r->nps_med);
+    if (r->base > 0) printf("%10.2f %6.2fx%s\n", r->base, ratio, slow ? "  REGRESSION" : "");
+    else             printf("%10s %7s\n", "-", "-");
+    fflush(stdout);
+  }
+
+  if (update) base_save(base, res, n, reps, scale);
+
+  if (regress)
+    fprintf(stderr, "ndbench: %d scenario(s) slower than baseline by more than %g%%\n",
+                    regress, 100*tol);
+
+  return regress ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+int
+main (int argc, char *argv[])
+{
+  if (argc < 3) usage();
+
+  if (!strcmp(argv[1], "gen")) return cmd_gen(argc, argv);
+  if (!strcmp(argv[1], "run")) return cmd_run(argc, argv);
+
+  usage();
+  return EXIT_FAILURE;
+}
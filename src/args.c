@@ -22,6 +22,7 @@
 #include "args.h"
 #include "utils.h"
 #include "utest.h"
+#include "report.h"
 #include "error.h"
 #include "ndiff.h"
 #include "context.h"
@@ -47,6 +48,10 @@
 #define MAXKEEP 25
 #endif
 
+#ifndef MAXWINDOW
+#define MAXWINDOW (1 << 26)
+#endif
+
 #ifndef CMTCHRS
 #define CMTCHRS ""
 #endif
@@ -95,6 +100,14 @@
 #define BZIP2CMD "bzip2 -cdq"
 #endif
 
+#ifndef ZCACHEMAX
+#define ZCACHEMAX 1024
+#endif
+
+#ifndef GOTOASYNC
+#define GOTOASYNC 4096
+#endif
+
 struct option option = {
   // index of processed option
   .argi = 1,
@@ -120,12 +133,21 @@ struct option option = {
   // number of registers allocated by default
   .nregs = MAXREGS,
 
+  // max size of line buffers (sliding window beyond)
+  .window = MAXWINDOW,
+
   // file extensions
   .out_e = OUTFILEEXT, .ref_e = REFFILEEXT,
   .cfg_e = CFGFILEEXT, .res_e = RESFILEEXT,
 
   // unzip commands
-  .unzip = { UNZIPCMD, GZIPCMD, BZIP2CMD}
+  .unzip = { UNZIPCMD, GZIPCMD, BZIP2CMD},
+
+  // size of the decompressed references cache (MB)
+  .zcache_max = ZCACHEMAX * 1000000LL,
+
+  // goto lines searched before searching the right side concurrently
+  .async = GOTOASYNC
 };
 
 static void
@@ -144,6 +166,32 @@ run_utest(void)
   utest_free(ut);
 }
 
+static void
+run_bench(void)
+{
+  struct utest *ut = utest_alloc(0);
+
+  inform("Running microbenchmarks");
+
+  // list of microbenchmarks
+  context_bench(ut);
+  ndiff_bench(ut);
+
+  utest_free(ut);
+}
+
+// parse a region first-last (or first-, first), last 0 when unbounded
+static void
+parse_region(const char *str, llong *first, llong *last, const char *what)
+{
+  char *end;
+
+  *first = *last = strtoll(str, &end, 10);
+  if (*end == '-') *last = *++end ? strtoll(end, &end, 10) : 0;
+
+  ensure(!*end && *first > 0 && (!*last || *last >= *first), "invalid region of %s '%s'", what, str);
+}
+
 void
 invalid_option(const char *str)
 {
@@ -167,42 +215,69 @@ usage(void)
   inform("\tndiff [options] fileA[.out] fileB[.ref] [fileC[.cfg]]");
   inform("\tndiff [options] --list fileA fileB ...");
   inform("\tndiff [options] --test '1st' fileA fileB --test '2nd' fileC ...");
+  inform("\tndiff [options] --tree dirA dirB [dirC]");
+  inform("\tndiff [options] --against fileB[.ref] fileA1 fileA2 ...");
 
   inform("");
   inform("options:");
   inform("\t-a  --accum file    accumulate tests information in file");
+  inform("\t    --against file  diff the next outputs against the reference file loaded once (worker processes, see --jobs)");
+  inform("\t    --async num     search the right side of goto actions on a thread after num lines (0 = never), default is %lld", option.async);
+  inform("\t    --bench         run the ndiff microbenchmarks (machine-readable output)");
   inform("\t-b  --blank         ignore blank spaces (space and tabs)");
+  inform("\t    --canon         rewrite numbers of result files in canonical form by rule (rounded, masked)");
   inform("\t    --cfgext ext    specify the config file extension, default is \"%s\"", option.cfg_e);
+  inform("\t    --cols a-b      diff only the number columns a to b of each row (a- for no end)");
   inform("\t-c  --comment chrs  comment characters, default is \"%s\"", option.cchr);
   inform("\t-d  --debug         enable debug mode (include xcheck mode)");
+  inform("\t    --errstats      display per column error statistics and suggested tolerances");
+  inform("\t    --flight num    record the last num events and display them on diffs and errors");
   inform("\t-h  --help          display this help");
+  inform("\t    --history       display per test throughput history from accumulated information");
+  inform("\t    --incr          rediff only the blocks changed since the previous run (digests in output file.incr)");
   inform("\t-i  --info          enable info mode (default)");
+  inform("\t    --jobs num      specify the number of worker processes in tree and against modes, default is online cpus");
   inform("\t-k  --keep num      specify the number of diffs to display per file, default is %d", option.keep);
   inform("\t    --lhsrec        recycle next left file (exclusive with --rhsrec)");
   inform("\t    --lhsres        echo valid lines of next left file to its result file");
   inform("\t-l  --list          enable list mode (list of filenames)");
   inform("\t    --long          disable short options");
+  inform("\t    --merge-accum files  merge the accumulated information of shards into the accumulation file");
   inform("\t    --nocolor       disable color output for PASS/FAIL");
   inform("\t    --noloc         disable C file location during trace");
   inform("\t    --nowarn        disable warnings");
   inform("\t    --nregs num     specify the number of registers to allocate");
   inform("\t    --outext ext    specify the output file extension, default is \"%s\"", option.out_e);
+  inform("\t    --perf          add hardware performance counters to --stats (Linux only)");
   inform("\t    --punct chrs    punctuation characters part of identifiers, default is \"%s\"", option.pchr);
   inform("\t-q  --quiet         enable quiet mode (no output if no diff)");
   inform("\t    --refext ext    specify the reference file extension, default is \"%s\"", option.ref_e);
   inform("\t    --regfmt fmt    specify the (printf) format fmt for register 0, default is \"%s\"", option.rfmt);
-  inform("\t-r  --reset         reset accumulated information");
+  inform("\t    --report file   write diffs to file instead of the console (buffered)");
+  inform("\t    --reportfmt fmt specify the report format: text (default), json (JSON Lines) or bin");
+  inform("\t-r  --reset         reset accumulated information (keep history)");
   inform("\t    --resext ext    specify the result file extension, default is \"%s\"", option.res_e);
   inform("\t    --rhsrec        recycle next right file (exclusive with --lhsrec)");
   inform("\t    --rhsres        echo valid lines of next right file to its result file");
+  inform("\t    --rows a-b      diff only the rows a to b, skip the rows before a at once (a- for no end)");
+  inform("\t    --rule-profile file  dump per-rule hit, failure and cost counters to file");
+  inform("\t    --sample r[:s]  check a pseudo-random fraction r of the rows (seed s), keep actions and registers");
   inform("\t-n  --serie         enable serie mode (indexed filenames)");
   inform("\t    --seriefmt fmt  specify the (printf) format fmt for indexes, default is \"%s\"", option.fmt);
+  inform("\t    --shard i/n     diff only the pairs of shard i of n (balanced by size, or by time with --shard-hist)");
+  inform("\t    --shard-hist file  balance the shards by the diff times of file (frozen copy of the accumulation file)");
+  inform("\t    --stats         display throughput statistics and estimated per-stage timing");
   inform("\t-s  --suite name    set test suite name for output message (title)");
   inform("\t    --suitefmt fmt  specify the (printf) format fmt for testsuite, default is \"%s\"", option.sfmt);
+  inform("\t    --summary       display the summary of accumulated information");
   inform("\t-t  --test name     set test name for output message (item)");
   inform("\t    --trace         enable trace mode (very verbose, include debug mode)");
+  inform("\t    --tree          enable tree mode (next dirs of outputs, references and configs)");
   inform("\t    --trunc         allow premature ending of one of the input file");
   inform("\t    --utest         run the ndiff unit tests (still incomplete)");
+  inform("\t    --watch         rediff the next pair each time its output file is rewritten (interrupt to stop)");
+  inform("\t    --window num    bound line buffers to num chars (slide over longer lines, 0 = unbounded), default is %d", option.window);
+  inform("\t    --within num    bound the searches of goto actions to num lines (0 = unbounded, default)");
   inform("\t-x  --xcheck        enable cross check mode (algorithms cross check)");
 
   inform("");
@@ -210,6 +285,7 @@ usage(void)
   inform("\t    --bzip2 cmd     command to uncompress .bz .bz2 .tbz .tbz2 files, default is \"%s\"", option.unzip[2]);
   inform("\t    --gzip  cmd     command to uncompress .gz .z .Z .tgz .taz .taZ files, default is \"%s\"", option.unzip[1]);
   inform("\t    --unzip cmd     command to uncompress .zip files, default is \"%s\"", option.unzip[0]);
+  inform("\t    --zcache dir[:mb] share decompressed references between processes in cache dir, default size is %d MB", ZCACHEMAX);
 
   inform("");
   inform("rules (%s):", option.cfg_e);
@@ -256,6 +332,7 @@ usage(void)
   inform("\t                    num < -1 in -abs and -rel (default, qualifier)");
   inform("\ttrace               trace rule when active (debug, qualifier)");
   inform("\ttraceR              trace rule and modified registers when active");
+  inform("\twithin=num          search goto tag at most num lines, else restore and fail (qualifier)");
 
   inform("");
   inform("registers:");
@@ -278,6 +355,9 @@ usage(void)
   inform("\tRn=Rp<Rq            load the min of registers p and q to register n");
   inform("\tRn=Rp>Rq            load the max of registers p and q to register n");
   inform("\tRn=Rp~Rq            move registers p..q to registers n..n+q-p");
+  inform("\tRn~Rm=Rp~Rq*Rr      apply the operation (+-*/%%^<>) to registers p..q and r");
+  inform("\tRn~Rm=Rp~Rq*Rr~Rs   apply the operation (+-*/%%^<>) to registers p..q and r..s");
+  inform("\tRn=+Rp~Rq           load the sum (+), product (*), min (<) or max (>) of registers p..q");
 
   inform("");
   inform("info   :\thttp://cern.ch/mad/ndiff");
@@ -301,6 +381,21 @@ clear_args(void)
     debug("recycling file(s) cleared");
     option.recycle = ndiff_norecycle;
   }
+
+  if (option.watch) {
+    debug("watch mode cleared");
+    option.watch = 0;
+  }
+
+  if (option.tree) {
+    debug("tree mode cleared");
+    option.tree = 0;
+  }
+
+  if (option.against) {
+    debug("against mode cleared");
+    option.against = 0;
+  }
 }
 
 void
@@ -319,6 +414,29 @@ parse_args(int argc, const char *argv[])
       continue;
     }
 
+    // set against mode reference [setup]
+    if (!strcmp(argv[option.argi], "--against")) {
+      option.against = argv[++option.argi];
+      debug("against mode reference set to '%s'", option.against);
+      continue;
+    }
+
+    // set goto concurrent search threshold [setup]
+    if (!strcmp(argv[option.argi], "--async")) {
+      char *end;
+      option.async = strtoll(argv[++option.argi], &end, 0);
+      ensure(!*end && option.async >= 0, "invalid goto concurrent search threshold '%s'", argv[option.argi]);
+      debug("goto concurrent search threshold set to %lld lines", option.async);
+      continue;
+    }
+
+    // run microbenchmarks [action]
+    if (!strcmp(argv[option.argi], "--bench")) {
+      run_bench();
+      option.utest += 1;
+      continue;
+    }
+
     // set blank mode [setup]
     if (!strcmp(argv[option.argi], "--blank") || (!option.lgopt && !strcmp(argv[option.argi], "-b"))) {
       debug("blank spaces ignored");
@@ -326,6 +444,13 @@ parse_args(int argc, const char *argv[])
       continue;
     }
 
+    // set canonical filter mode [setup]
+    if (!strcmp(argv[option.argi], "--canon")) {
+      debug("canonical filter mode on");
+      option.canon = 1;
+      continue;
+    }
+
     // set config extension [setup]
     if (!strcmp(argv[option.argi], "--cfgext")) {
       option.cfg_e = argv[++option.argi]; 
@@ -333,6 +458,13 @@ parse_args(int argc, const char *argv[])
       continue;
     }
 
+    // set region of number columns [setup]
+    if (!strcmp(argv[option.argi], "--cols")) {
+      parse_region(argv[++option.argi], &option.cols_f, &option.cols_l, "columns");
+      debug("region of number columns set to %lld-%lld", option.cols_f, option.cols_l);
+      continue;
+    }
+
     // set comment characters [setup]
     if (!strcmp(argv[option.argi], "--comment") || (!option.lgopt && !strcmp(argv[option.argi], "-c"))) {
       option.cchr = argv[++option.argi]; 
@@ -350,12 +482,41 @@ parse_args(int argc, const char *argv[])
       continue;
     }
 
+    // set error statistics mode [setup]
+    if (!strcmp(argv[option.argi], "--errstats")) {
+      debug("error statistics mode on");
+      option.errstats = 1;
+      continue;
+    }
+
+    // set flight recorder size [setup]
+    if (!strcmp(argv[option.argi], "--flight")) {
+      option.flight = strtoul(argv[++option.argi],0,0);
+      debug("flight recorder size set to %d", option.flight);
+      continue;
+    }
+
     // display help [action]
     if (!strcmp(argv[option.argi], "--help") || (!option.lgopt && !strcmp(argv[option.argi], "-h"))) {
       usage();
       continue;
     }
 
+    // display accumulated throughput history [action]
+    if (!strcmp(argv[option.argi], "--history")) {
+      ensure(option.accum, "no accumulation file specified");
+      debug("displaying history from file '%s'", option.accum);
+      accum_history(stdout);
+      continue;
+    }
+
+    // set incremental mode [setup]
+    if (!strcmp(argv[option.argi], "--incr")) {
+      debug("incremental mode on");
+      option.incr = 1;
+      continue;
+    }
+
     // set info mode [setup]
     if (!strcmp(argv[option.argi], "--info") || (!option.lgopt && !strcmp(argv[option.argi], "-i"))) {
       debug("info mode on");
@@ -364,6 +525,13 @@ parse_args(int argc, const char *argv[])
       continue;
     }
 
+    // set number of jobs [setup]
+    if (!strcmp(argv[option.argi], "--jobs")) {
+      option.jobs = strtoul(argv[++option.argi],0,0);
+      debug("jobs set to %d", option.jobs);
+      continue;
+    }
+
     // set keep number [setup]
     if (!strcmp(argv[option.argi], "--keep") || (!option.lgopt && !strcmp(argv[option.argi], "-k"))) {
       option.keep = strtoul(argv[++option.argi],0,0);
@@ -399,6 +567,17 @@ parse_args(int argc, const char *argv[])
       continue;
     }
 
+    // merge accumulation files of shards [action]
+    if (!strcmp(argv[option.argi], "--merge-accum")) {
+      ensure(option.accum, "no accumulation file specified");
+      int i = option.argi+1;
+      while (i < argc && !is_option(argv[i])) i++;
+      debug("merging %d file(s) into file '%s'", i-option.argi-1, option.accum);
+      accum_merge(argv+option.argi+1, i-option.argi-1);
+      option.argi = i-1;
+      continue;
+    }
+
 
     // disable color [setup]
     if (!strcmp(argv[option.argi], "--nocolor")) {
@@ -438,6 +617,13 @@ parse_args(int argc, const char *argv[])
       continue;
     }
 
+    // set hardware counters mode [setup]
+    if (!strcmp(argv[option.argi], "--perf")) {
+      debug("hardware counters mode on");
+      option.perf = option.stats = 1;
+      continue;
+    }
+
     // set punctuation characters [setup]
     if (!strcmp(argv[option.argi], "--punct")) {
       option.pchr = argv[++option.argi]; 
@@ -467,6 +653,22 @@ parse_args(int argc, const char *argv[])
       continue;
     }
 
+    // set report filename [setup]
+    if (!strcmp(argv[option.argi], "--report")) {
+      option.report = argv[++option.argi];
+      debug("report filename set to '%s'", option.report);
+      continue;
+    }
+
+    // set report format [setup]
+    if (!strcmp(argv[option.argi], "--reportfmt")) {
+      const char *fmt = argv[++option.argi];
+      option.repfmt = report_format(fmt);
+      ensure(option.repfmt >= 0, "invalid report format '%s'", fmt);
+      debug("report format set to '%s'", fmt);
+      continue;
+    }
+
     // set result extension [setup]
     if (!strcmp(argv[option.argi], "--resext")) {
       option.res_e = argv[++option.argi]; 
@@ -478,8 +680,7 @@ parse_args(int argc, const char *argv[])
     if (!strcmp(argv[option.argi], "--reset") || (!option.lgopt && !strcmp(argv[option.argi], "-r"))) {
       ensure(option.accum, "no accumulation file specified");
       debug("reseting file '%s'", option.accum);
-      option.reset = 1;
-      accum_summary(0, 0, 0, 0);
+      accum_reset();
       continue;
     }
 
@@ -497,6 +698,30 @@ parse_args(int argc, const char *argv[])
       continue;
     }
 
+    // set region of rows [setup]
+    if (!strcmp(argv[option.argi], "--rows")) {
+      parse_region(argv[++option.argi], &option.rows_f, &option.rows_l, "rows");
+      debug("region of rows set to %lld-%lld", option.rows_f, option.rows_l);
+      continue;
+    }
+
+    // set rule profile filename [setup]
+    if (!strcmp(argv[option.argi], "--rule-profile")) {
+      option.rprof = argv[++option.argi];
+      debug("rule profile filename set to '%s'", option.rprof);
+      continue;
+    }
+
+    // set sampling rate and seed [setup]
+    if (!strcmp(argv[option.argi], "--sample")) {
+      char *end;
+      option.sample = strtod(argv[++option.argi], &end);
+      option.sample_seed = *end == ':' ? strtoull(end+1, &end, 0) : 0;
+      ensure(!*end && option.sample > 0 && option.sample <= 1, "invalid sampling rate '%s'", argv[option.argi]);
+      debug("sampling rate set to %g (seed %llu)", option.sample, option.sample_seed);
+      continue;
+    }
+
     // set serie mode [setup]
     if (!strcmp(argv[option.argi], "--serie") || (!option.lgopt && !strcmp(argv[option.argi], "-n"))) {
       debug("serie mode on");
@@ -511,6 +736,30 @@ parse_args(int argc, const char *argv[])
       continue;
     }
 
+    // set shard [setup]
+    if (!strcmp(argv[option.argi], "--shard")) {
+      const char *str = argv[++option.argi];
+      int pos = 0;
+      ensure(sscanf(str, "%d/%d%n", &option.shard_i, &option.shard_n, &pos) == 2 && !str[pos] &&
+             option.shard_i >= 1 && option.shard_i <= option.shard_n, "invalid shard '%s'", str);
+      debug("shard set to %d of %d", option.shard_i, option.shard_n);
+      continue;
+    }
+
+    // set shard history [setup]
+    if (!strcmp(argv[option.argi], "--shard-hist")) {
+      option.shard_h = argv[++option.argi];
+      debug("shard history set to '%s'", option.shard_h);
+      continue;
+    }
+
+    // set statistics mode [setup]
+    if (!strcmp(argv[option.argi], "--stats")) {
+      debug("statistics mode on");
+      option.stats = 1;
+      continue;
+    }
+
     // set suite name [setup]
     if (!strcmp(argv[option.argi], "--suite") || (!option.lgopt && !strcmp(argv[option.argi], "-s"))) {
       option.suite = argv[++option.argi];
@@ -525,6 +774,14 @@ parse_args(int argc, const char *argv[])
       continue;
     }
 
+    // display accumulated summary [action]
+    if (!strcmp(argv[option.argi], "--summary")) {
+      ensure(option.accum, "no accumulation file specified");
+      debug("displaying summary from file '%s'", option.accum);
+      accum_summary(stdout);
+      continue;
+    }
+
     // set test name [setup]
     if (!strcmp(argv[option.argi], "--test") || (!option.lgopt && !strcmp(argv[option.argi], "-t"))) {
       option.test = argv[++option.argi];
@@ -542,6 +799,13 @@ parse_args(int argc, const char *argv[])
       continue;
     }
 
+    // set tree mode [setup]
+    if (!strcmp(argv[option.argi], "--tree")) {
+      debug("tree mode on");
+      option.tree = 1;
+      continue;
+    }
+
     // enable truncation [setup]
     if (!strcmp(argv[option.argi], "--trunc")) {
       debug("premature truncation allowed");
@@ -556,6 +820,29 @@ parse_args(int argc, const char *argv[])
       continue;
     }
 
+    // set watch mode [setup]
+    if (!strcmp(argv[option.argi], "--watch")) {
+      debug("watch mode on");
+      option.watch = 1;
+      continue;
+    }
+
+    // set line window size [setup]
+    if (!strcmp(argv[option.argi], "--window")) {
+      option.window = strtoul(argv[++option.argi],0,0);
+      debug("line window size set to %d", option.window);
+      continue;
+    }
+
+    // set goto search limit [setup]
+    if (!strcmp(argv[option.argi], "--within")) {
+      char *end;
+      option.within = strtoll(argv[++option.argi], &end, 0);
+      ensure(!*end && option.within >= 0, "invalid goto search limit '%s'", argv[option.argi]);
+      debug("goto search limit set to %lld lines", option.within);
+      continue;
+    }
+
     // set check mode [setup]
     if (!strcmp(argv[option.argi], "--xcheck") || (!option.lgopt && !strcmp(argv[option.argi], "-x"))) {
       debug("check mode on");
@@ -586,6 +873,19 @@ parse_args(int argc, const char *argv[])
       continue;
     }
 
+    // set decompressed references cache [setup]
+    if (!strcmp(argv[option.argi], "--zcache")) {
+      char *str = (char*)argv[++option.argi], *end = strrchr(str, ':');
+      option.zcache = str;
+      if (end) {
+        option.zcache_max = strtoll(end+1, &str, 0) * 1000000LL;
+        ensure(!*str && option.zcache_max > 0, "invalid cache size '%s'", end+1);
+        *end = 0;
+      }
+      debug("references cache set to '%s' (%lld bytes)", option.zcache, option.zcache_max);
+      continue;
+    }
+
 // ---- [unknown]
     invalid_option(argv[option.argi]);
   }
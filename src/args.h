@@ -25,12 +25,15 @@
 
 struct option {
   int check, debug, nowarn, keep, lgopt;
-  int serie, list, blank, utest, reset, trunc, nregs, recycle;
+  int serie, list, blank, utest, trunc, nregs, recycle, stats, perf, flight, repfmt, errstats, window, watch, tree, jobs;
+  int shard_i, shard_n, canon, incr;
+  const char *shard_h;
   const char *suite, *test;
   const char *fmt, *sfmt, *rfmt;
   const char *pchr, *cchr;
   const char *out_e, *ref_e, *cfg_e, *res_e;
   const char *unzip[3];
+  const char *zcache; llong zcache_max;
   char lhs_file[FILENAME_MAX];
   char rhs_file[FILENAME_MAX];
   char cfg_file[FILENAME_MAX];
@@ -38,7 +41,10 @@ struct option {
   int  lhs_res, rhs_res;
   int  argi;
 
-  const char *accum;
+  const char *accum, *rprof, *report, *against;
+  double sample; ullong sample_seed;
+  llong within, async;
+  llong rows_f, rows_l, cols_f, cols_l;
   time_t dat_t0;
   double clk_t0, clk_t1;
 };
@@ -20,6 +20,7 @@
 #include <string.h>
 #include <ctype.h>
 #include <float.h>
+#include <math.h>
 
 #include "args.h"
 #include "utils.h"
@@ -40,7 +41,7 @@ printSlc(const S *s, FILE *out)
     return;
   }
 
-  fprintf(out, "%u", slice_first(s));
+  fprintf(out, "%llu", slice_first(s));
 
   if (slice_isUnit(s)) return;
 
@@ -48,7 +49,7 @@ printSlc(const S *s, FILE *out)
     putc('-', out);
     putc('$', out);
   } else
-   fprintf(out, "-%u", slice_last(s));
+   fprintf(out, "-%llu", slice_last(s));
 
   if (slice_stride(s) != 1)
     fprintf(out, "/%u", slice_stride(s));    
@@ -58,17 +59,18 @@ static int
 readSlcOrRng(S *s, FILE *in)
 {
   int c, r = 1;
-  uint first=0, last=0, stride=1;
+  ullong first=0, last=0;
+  uint stride=1;
 
   // skip spaces
   while((c = getc(in)) != EOF && isblank(c)) ;
   if (c == EOF) return EOF;
 
   // ('*'|num)
-  if (c == '*') { last = UINT_MAX; goto finish; }
+  if (c == '*') { last = ULLONG_MAX; goto finish; }
   else {
     ungetc(c, in);
-    if (fscanf(in, "%u", &first) != 1) return EOF;
+    if (fscanf(in, "%llu", &first) != 1) return EOF;
   }
 
   // (':'|'-')?
@@ -79,10 +81,10 @@ readSlcOrRng(S *s, FILE *in)
 
   // ('$'|num)
   c = getc(in);
-  if (c == '$') last = UINT_MAX;
+  if (c == '$') last = ULLONG_MAX;
   else {
     ungetc(c, in);
-    if (fscanf(in, "%u", &last) != 1) return EOF;
+    if (fscanf(in, "%llu", &last) != 1) return EOF;
   }
 
   // ('/'num)? 
@@ -97,7 +99,7 @@ finish:
   else
     *s = slice_initSizeStride(first, last, stride);
 
-  trace("<-readSlcOrRng %u%c%u/%u", first, r ? '-' : ':', last, stride);
+  trace("<-readSlcOrRng %llu%c%llu/%u", first, r ? '-' : ':', last, stride);
 
   return 0;
 }
@@ -205,38 +207,82 @@ readEps(struct eps *e, FILE *in, int row)
       if (*str == 'R' && strchr(buf,'R')) {
         ensure(e->op_n < (short)sizeof e->op, "rule has too many operations (%s:%d)", option.cfg_file, row);
 
-        short dst = strtoul(str+1, &end, 10);
+        short dst = strtoul(str+1, &end, 10), dst2 = 0;
+        if (*end == '~' && end[1] == 'R') dst2 = strtoul(end+2, &end, 10);
         ensure(dst>=0 && dst < REG_MAX && !*end, "invalid register reference '%s' (%s:%d)", str, option.cfg_file, row);
         ensure(!dst || dst>9, "invalid assignment to read-only register R%d (%s:%d)", dst, option.cfg_file, row);
 
-        char  bop=0;
-        short src=0, src2=0;
-        bool  pfx = *buf != 'R';
-        char  op[2] = { pfx ? *buf : 0, 0 };
-        int   n = sscanf(buf+pfx, "R%hd%cR%hd", &src, &bop, &src2);
-
-        if (n == 1) {
-          trace("[%d] R%d=%sR%d", row, dst, op, src);
-          ensure(!pfx || strchr(REG_UNARY_OP,*buf), "invalid unary operation '%c' (%s:%d)", *buf, option.cfg_file, row);
-          e->dst [e->op_n] = dst;
-          e->src [e->op_n] = reg_encode(src, *op);
-          e->src2[e->op_n] = 0;
-          e->op  [e->op_n] = 0;
-          e->op_n++;
-        }
-        else if (n == 3) {
-          trace("[%d] R%d=R%d%cR%d", row, dst, src, bop, src2);
-          ensure(!pfx, "unallowed prefix operation '%s' (%s:%d)", buf, option.cfg_file, row);
-          ensure(strchr(REG_BINARY_OP,bop), "invalid binary operation '%c' (%s:%d)", bop, option.cfg_file, row);
-          ensure(reg_isvalid(src ), "invalid register reference '%d' (%s:%d)", src , option.cfg_file, row);
-          ensure(reg_isvalid(src2), "invalid register reference '%d' (%s:%d)", src2, option.cfg_file, row);
+        // --- range operations
+        if (dst2) {
+          char  bop=0;
+          short src=0, src_e=0, src2=0, src2_e=0;
+          int   n = sscanf(buf, "R%hd~R%hd%cR%hd~R%hd", &src, &src_e, &bop, &src2, &src2_e);
+
+          trace("[%d] R%d~R%d=%s", row, dst, dst2, buf);
+          ensure(dst && dst < dst2 && dst2 < REG_MAX, "invalid range of registers R%d~R%d (%s:%d)", dst, dst2, option.cfg_file, row);
+          ensure(n == 4 || n == 5, "invalid range operation '%s' (%s:%d)", buf, option.cfg_file, row);
+          ensure(strchr(REG_RANGE_OP,bop), "invalid range operation '%c' (%s:%d)", bop, option.cfg_file, row);
+          ensure(reg_isvalid(src) && reg_isvalid(src2), "invalid register reference '%s' (%s:%d)", buf, option.cfg_file, row);
+          ensure(src_e-src == dst2-dst && (n == 4 || src2_e-src2 == dst2-dst),
+                 "mismatched ranges of registers '%s=%s' (%s:%d)", str, buf, option.cfg_file, row);
           e->dst [e->op_n] = dst;
+          e->dst2[e->op_n] = dst2;
           e->src [e->op_n] = src;
           e->src2[e->op_n] = src2;
           e->op  [e->op_n] = bop;
+          e->form[e->op_n] = n == 4 ? reg_range : reg_ranges;
           e->op_n++;
         }
-        else EPS_INVALID;
+
+        // --- scalar operations
+        else {
+          char  bop=0;
+          short src=0, src2=0;
+          bool  pfx = *buf != 'R';
+          char  op[2] = { pfx ? *buf : 0, 0 };
+          int   n = sscanf(buf+pfx, "R%hd%cR%hd", &src, &bop, &src2);
+
+          if (n == 1) {
+            trace("[%d] R%d=%sR%d", row, dst, op, src);
+            ensure(!pfx || strchr(REG_UNARY_OP,*buf), "invalid unary operation '%c' (%s:%d)", *buf, option.cfg_file, row);
+            e->dst [e->op_n] = dst;
+            e->dst2[e->op_n] = 0;
+            e->src [e->op_n] = reg_encode(src, *op);
+            e->src2[e->op_n] = 0;
+            e->op  [e->op_n] = 0;
+            e->form[e->op_n] = reg_scalar;
+            e->op_n++;
+          }
+          else if (n == 3 && pfx && bop == '~') {
+            trace("[%d] R%d=%sR%d~R%d", row, dst, op, src, src2);
+            ensure(strchr(REG_REDUCE_OP,*buf), "invalid reduction '%c' (%s:%d)", *buf, option.cfg_file, row);
+            ensure(reg_isvalid(src ), "invalid register reference '%d' (%s:%d)", src , option.cfg_file, row);
+            ensure(reg_isvalid(src2), "invalid register reference '%d' (%s:%d)", src2, option.cfg_file, row);
+            ensure(src < src2, "invalid range of registers R%d~R%d (%s:%d)", src, src2, option.cfg_file, row);
+            e->dst [e->op_n] = dst;
+            e->dst2[e->op_n] = 0;
+            e->src [e->op_n] = src;
+            e->src2[e->op_n] = src2;
+            e->op  [e->op_n] = *buf;
+            e->form[e->op_n] = reg_reduce;
+            e->op_n++;
+          }
+          else if (n == 3) {
+            trace("[%d] R%d=R%d%cR%d", row, dst, src, bop, src2);
+            ensure(!pfx, "unallowed prefix operation '%s' (%s:%d)", buf, option.cfg_file, row);
+            ensure(strchr(REG_BINARY_OP,bop), "invalid binary operation '%c' (%s:%d)", bop, option.cfg_file, row);
+            ensure(reg_isvalid(src ), "invalid register reference '%d' (%s:%d)", src , option.cfg_file, row);
+            ensure(reg_isvalid(src2), "invalid register reference '%d' (%s:%d)", src2, option.cfg_file, row);
+            e->dst [e->op_n] = dst;
+            e->dst2[e->op_n] = 0;
+            e->src [e->op_n] = src;
+            e->src2[e->op_n] = src2;
+            e->op  [e->op_n] = bop;
+            e->form[e->op_n] = reg_scalar;
+            e->op_n++;
+          }
+          else EPS_INVALID;
+        }
       }
 
       // --- load registers
@@ -325,6 +371,10 @@ readEps(struct eps *e, FILE *in, int row)
           cmd |= eps_dig;   e->_dig = val;  trace("[%d] -dig=%g", row, val);
           ensure(e->_dig <= -1.0, "invalid negative digital relative constraint (%s:%d)", option.cfg_file, row);
         }
+        else if (strcmp(str, "within") == 0) {
+          ensure(val >= 1 && val < 1e18 && val == floor(val), "invalid goto search limit (%s:%d)", option.cfg_file, row);
+                            e->gto_max = val;  trace("[%d] within=%lld", row, e->gto_max);
+        }
         else EPS_INVALID;
 
       }
@@ -336,6 +386,8 @@ readEps(struct eps *e, FILE *in, int row)
     if (c == EOF || (isspace(c) && !isblank(c)) || c == '#' || c == '!') break; 
   }
 
+  ensure(!e->gto_max || cmd & (eps_goto | eps_gonum), "search limit without goto (%s:%d)", option.cfg_file, row);
+
   // default: abs=eps
   if (!(cmd & (eps_chk | eps_sgg))) {
     cmd |= eps_abs;  e->abs = DBL_MIN;  trace("[%d] abs=%g", row, e->abs);
@@ -387,6 +439,8 @@ constraint_print(const T* cst, FILE *out)
     else fprintf(out, "goto='%s' (num) ", cst->eps.tag);
   }
 
+  if (cst->eps.gto_max)  fprintf(out, "within=%lld ", cst->eps.gto_max);
+
   if (cst->eps.cmd & eps_lhs) {
     if (cst->eps.lhs_reg) {
       rn = reg_decode(cst->eps.lhs_reg, op);
@@ -471,7 +525,17 @@ constraint_print(const T* cst, FILE *out)
 
 // --- operations
   for (int j=0; j < cst->eps.op_n; j++) {
-    if (cst->eps.op[j])
+    short n = cst->eps.dst2[j]-cst->eps.dst[j];
+
+    if (cst->eps.form[j] == reg_range)
+      fprintf(out, "R%d~R%d=R%d~R%d%cR%d ", cst->eps.dst[j], cst->eps.dst2[j],
+              cst->eps.src[j], cst->eps.src[j]+n, cst->eps.op[j], cst->eps.src2[j]);
+    else if (cst->eps.form[j] == reg_ranges)
+      fprintf(out, "R%d~R%d=R%d~R%d%cR%d~R%d ", cst->eps.dst[j], cst->eps.dst2[j],
+              cst->eps.src[j], cst->eps.src[j]+n, cst->eps.op[j], cst->eps.src2[j], cst->eps.src2[j]+n);
+    else if (cst->eps.form[j] == reg_reduce)
+      fprintf(out, "R%d=%cR%d~R%d ", cst->eps.dst[j], cst->eps.op[j], cst->eps.src[j], cst->eps.src2[j]);
+    else if (cst->eps.op[j])
       fprintf(out, "R%d=R%d%cR%d ", cst->eps.dst[j], cst->eps.src[j], cst->eps.op[j], cst->eps.src2[j]);
     else {
       rn = reg_decode(cst->eps.src[j], op);
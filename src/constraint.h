@@ -104,6 +104,7 @@ struct eps {
   double  abs,  rel,  dig;
   double _abs, _rel, _dig;
   double  num;
+  llong   gto_max; // goto search limit (lines), 0: default
 
   // loads
   short   lhs_reg,  rhs_reg;
@@ -114,7 +115,8 @@ struct eps {
 
   // operations
   short   dst[MAXREGOP], src[MAXREGOP], src2[MAXREGOP], op_n;
-  char    op [MAXREGOP];
+  short   dst2[MAXREGOP]; // end of destination range
+  char    op [MAXREGOP], form[MAXREGOP];
 
   // tags
   char    tag[MAXTAGLEN];
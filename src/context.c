@@ -16,6 +16,7 @@
 */
 
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 #include <float.h>
 
@@ -35,9 +36,13 @@ struct context {
   int fut_n, act_n, row_n;
 
   // current status
-  int row_u, row_i, col_i;
+  llong row_u, row_i, col_i;
   bool sorted;
 
+  // profile counters (optional)
+  struct context_prof *prof;
+  int prof_n;
+
   // storage
   int dat_n, dat_sz;
   C dat[];
@@ -46,7 +51,7 @@ struct context {
 // ----- forward decl
 
 static void
-ut_trace(const T *cxt, int i, int j, const C* cst1, const C* cst2);
+ut_trace(const T *cxt, llong i, llong j, const C* cst1, const C* cst2);
 
 // ----- private (sort helpers)
 
@@ -108,7 +113,9 @@ context_teardown (T *cxt)
 
   *cxt = (T) {
       .dat_n  = cxt->dat_n,
-      .dat_sz = cxt->dat_sz
+      .dat_sz = cxt->dat_sz,
+      .prof   = cxt->prof,
+      .prof_n = cxt->prof_n
     };  
 }
 
@@ -140,18 +147,18 @@ context_add0(T *cxt)
 // ----- private (eps helpers)
 
 static inline void
-context_updateAct (T *cxt, int row_i)
+context_updateAct (T *cxt, llong row_i)
 {
-  trace("->updateAct row %d", row_i);
+  trace("->updateAct row %lld", row_i);
   int na = cxt->act_n;
 
   // remove obsolete constraints
   for (; cxt->act_n; --cxt->act_n) {
     const C *act = cxt->act[cxt->act_n-1];
-    uint i = slice_last(&act->row);
+    ullong i = slice_last(&act->row);
 
-    if (i >= (uint)row_i) {
-      if (i < (uint)cxt->row_u) cxt->row_u = i;
+    if (i >= (ullong)row_i) {
+      if (i < (ullong)cxt->row_u) cxt->row_u = i;
       break;
     }
   }
@@ -161,14 +168,14 @@ context_updateAct (T *cxt, int row_i)
   // select future constraints
   for (; cxt->fut_n; --cxt->fut_n) {
     const C *fut = cxt->fut[cxt->fut_n-1];
-    uint i = slice_first(&fut->row);
+    ullong i = slice_first(&fut->row);
 
-    if (i > (uint)row_i) {         // not yet active
-      if (i < (uint)cxt->row_u) cxt->row_u = i;
+    if (i > (ullong)row_i) {       // not yet active
+      if (i < (ullong)cxt->row_u) cxt->row_u = i;
       break;
     }
 
-    if (slice_last(&fut->row) < (uint)row_i) continue; // already obsolete
+    if (slice_last(&fut->row) < (ullong)row_i) continue; // already obsolete
 
     // insert future constraint
     if (!cxt->act_n) *cxt->act = fut;
@@ -184,13 +191,13 @@ context_updateAct (T *cxt, int row_i)
   }
 
   trace("%d future constraints added", cxt->act_n-na);
-  trace("<-updateAct row %d", row_i);
+  trace("<-updateAct row %lld", row_i);
 }
 
 static inline void
-context_setupRow (T *cxt, int row_i)
+context_setupRow (T *cxt, llong row_i)
 {
-  trace("->setupRow row %d", row_i);
+  trace("->setupRow row %lld", row_i);
   cxt->row_n = 0;
 
   // select active constraints for this row
@@ -209,15 +216,19 @@ context_setupRow (T *cxt, int row_i)
     cxt->row[cxt->row_n++] = act;
   }
 
+  if (cxt->prof)
+    for (int i = 0; i < cxt->row_n; ++i)
+      cxt->prof[cxt->row[i]->idx].rows++;
+
   trace("%d active constraints selected ([0] #%d, line %d)",
         cxt->row_n, cxt->row[0]->idx, cxt->row[0]->line);
-  trace("<-setupRow row %d", row_i);
+  trace("<-setupRow row %lld", row_i);
 }
 
 static inline const C*
-context_setupCol (T *cxt, int col_i)
+context_setupCol (T *cxt, llong col_i)
 {
-  trace("->setupCol col %d", col_i);
+  trace("->setupCol col %lld", col_i);
   const C *cst = 0;
 
   // select last-added active constraint for this col
@@ -228,13 +239,13 @@ context_setupCol (T *cxt, int col_i)
   }
 
   trace("constraint #%d (line %d) selected", cst->idx, cst->line);
-  trace("<-setupCol col %d", col_i);
+  trace("<-setupCol col %lld", col_i);
 
   return cst;
 }
 
 static inline const C*
-context_getIncCst (T *cxt, int row_i, int col_i)
+context_getIncCst (T *cxt, llong row_i, llong col_i)
 {
   const C *cst = 0;
 
@@ -260,7 +271,7 @@ context_getIncCst (T *cxt, int row_i, int col_i)
 }
 
 static inline const C*
-context_getAtCst (T *cxt, int row_i, int col_i)
+context_getAtCst (T *cxt, llong row_i, llong col_i)
 {
   const C *cur = cxt->dat+cxt->dat_n-1;
   const C *cst = 0;
@@ -301,12 +312,20 @@ context_alloc (int n)
   return cxt;
 }
 
+void
+context_reset (T *cxt)
+{
+  assert(cxt);
+  context_teardown(cxt);
+}
+
 void
 context_clear (T *cxt)
 {
   assert(cxt);
   context_teardown(cxt);
   cxt->dat_n = 0;
+  if (cxt->prof) memset(cxt->prof, 0, cxt->prof_n * sizeof *cxt->prof);
   context_add0(cxt);
 }
 
@@ -315,6 +334,7 @@ context_free (T *cxt)
 {
   assert(cxt);
   context_teardown(cxt);
+  free(cxt->prof);
   free(cxt);
 }
 
@@ -344,6 +364,9 @@ context_add (T *cxt, const C *cst)
 
   cxt->dat_n++;
 
+  // keep profile in sync
+  if (cxt->prof) context_profile(cxt);
+
   return cxt;
 }
 
@@ -358,7 +381,7 @@ context_onfail(T *cxt, const C* cst)
 }
 
 const C*
-context_getAt (T *cxt, int row, int col)
+context_getAt (T *cxt, llong row, llong col)
 {
   assert(cxt);
   ensure(row > 0, "null row");
@@ -371,7 +394,7 @@ context_getAt (T *cxt, int row, int col)
 }
 
 const C*
-context_getInc (T *cxt, int row, int col)
+context_getInc (T *cxt, llong row, llong col)
 {
   assert(cxt);
   ensure(row > 0, "null row");
@@ -383,6 +406,32 @@ context_getInc (T *cxt, int row, int col)
   return context_getIncCst(cxt, row, col);
 }
 
+llong
+context_lastRow (const T *cxt, const C *cst)
+{
+  assert(cxt && cst);
+  llong row = cxt->row_i;
+
+  // only a dense action selected alone by getInc
+  if (!cxt->sorted || cxt->row_n != 1 || cxt->row[0] != cst ||
+      cst->eps.cmd < eps_skip || !slice_isDense(&cst->row))
+    return row;
+
+  // a strided constraint sorted before may become active
+  for (int i = 0; cxt->act[i] != cst; i++)
+    if (!slice_isDense(&cxt->act[i]->row)) return row;
+
+  ullong last = slice_last(&cst->row);
+
+  // the next future constraint may become active
+  if (cxt->fut_n) {
+    ullong first = slice_first(&cxt->fut[cxt->fut_n-1]->row);
+    if (first-1 < last) last = first-1;
+  }
+
+  return last > LLONG_MAX ? LLONG_MAX : (llong)last;
+}
+
 const C*
 context_getIdx (const T *cxt, int idx)
 {
@@ -406,6 +455,34 @@ context_findLine (const T *cxt, const C *cst)
          cst->line <= cxt->dat[cxt->dat_n-1].line ? cst->line : -1;
 }
 
+long
+context_memsize (const T *cxt)
+{
+  assert(cxt);
+  return sizeof *cxt + cxt->dat_sz * sizeof *cxt->dat +
+         (cxt->sorted == true ? 3 * cxt->dat_n * sizeof *cxt->fut : 0);
+}
+
+void
+context_profile (T *cxt)
+{
+  assert(cxt);
+
+  if (cxt->prof_n < cxt->dat_sz) {
+    cxt->prof = realloc(cxt->prof, cxt->dat_sz * sizeof *cxt->prof);
+    ensure(cxt->prof, "out of memory");
+    memset(cxt->prof+cxt->prof_n, 0, (cxt->dat_sz-cxt->prof_n) * sizeof *cxt->prof);
+    cxt->prof_n = cxt->dat_sz;
+  }
+}
+
+struct context_prof*
+context_getProf (T *cxt)
+{
+  assert(cxt);
+  return cxt->prof;
+}
+
 T*
 context_scan(T *cxt, FILE *fp)
 {
@@ -433,6 +510,24 @@ context_print(const T *cxt, FILE *fp)
   }
 }
 
+void
+context_printProf(const T *cxt, FILE *fp)
+{
+  const C *c;
+
+  if (!cxt->prof) return;
+
+  fprintf(fp, "#  idx  line         rows         nums        fails         acts      time(s)  rule\n");
+
+  for (int i = 0; (c = context_getIdx(cxt, i)) != 0; i++) {
+    const struct context_prof *p = cxt->prof+i;
+    fprintf(fp, "%6d %5d %12lld %12lld %12lld %12lld %12.6f  ",
+                i, c->line, p->rows, p->nums, p->fails, p->acts, p->time);
+    constraint_print(c, fp);
+    putc('\n', fp);
+  }
+}
+
 #undef T
 #undef C
 
@@ -449,12 +544,15 @@ context_print(const T *cxt, FILE *fp)
 
 enum { NROW = 5, NCOL = 5 };
 
+// first row past the 32-bit limit
+static const llong BIGROW = 4294967296LL;
+
 // ----- debug
 
 static void
-ut_trace(const T *cxt, int i, int j, const C* cst1, const C* cst2)
+ut_trace(const T *cxt, llong i, llong j, const C* cst1, const C* cst2)
 {
-  fprintf(stderr, "(%d,%d)\n", i, j);
+  fprintf(stderr, "(%lld,%lld)\n", i, j);
   if (cst1) {
     fprintf(stderr, "[%d].1: ", context_findIdx(cxt, cst1));
     constraint_print(cst1, stderr);
@@ -498,14 +596,14 @@ ut_teardown(T *cxt)
 */
 
 static void
-ut_testAt(struct utest *utest, T* cxt, int i, int j)
+ut_testAt(struct utest *utest, T* cxt, llong i, llong j)
 {
   const C* cst = context_getAt(cxt, i, j);
   UTEST(cst || !cst);
 }
 
 static void
-ut_testInc(struct utest *utest, T* cxt, int i, int j)
+ut_testInc(struct utest *utest, T* cxt, llong i, llong j)
 {
   const C* cst = context_getInc(cxt, i, j);
   UTEST(cst || !cst);
@@ -513,7 +611,7 @@ ut_testInc(struct utest *utest, T* cxt, int i, int j)
 #endif
 
 static void
-ut_testNul(struct utest *utest, T* cxt, int i, int j)
+ut_testNul(struct utest *utest, T* cxt, llong i, llong j)
 {
   const C* cst1 = context_getAt (cxt, i, j);
   const C* cst2 = context_getInc(cxt, i, j);
@@ -527,7 +625,7 @@ ut_testNul(struct utest *utest, T* cxt, int i, int j)
 }
 
 static void
-ut_testEqu(struct utest *utest, T* cxt, int i, int j)
+ut_testEqu(struct utest *utest, T* cxt, llong i, llong j)
 {
   const C* cst1 = context_getAt (cxt, i, j);
   const C* cst2 = context_getInc(cxt, i, j);
@@ -540,6 +638,26 @@ ut_testEqu(struct utest *utest, T* cxt, int i, int j)
     ut_trace(cxt, i, j, cst1, cst2);
 }
 
+static void
+ut_testBig(struct utest *utest, T* cxt, llong i, llong j)
+{
+  llong row = BIGROW + i;
+  ut_testEqu(utest, cxt, row, j);
+
+  const C* cst = context_getAt(cxt, row, j);
+
+  UTEST(!cst || (slice_isElem(&cst->row, row) &&
+                 ((cst->eps.cmd & eps_skip) || slice_isElem(&cst->col, j))));
+
+  // no truncation of rows to 32-bit
+  if (i == 1 && j == 2)
+    UTEST(cst == context_getIdx(cxt, 1));
+
+  // strided rule sorted before the skip, no bulk skip
+  if (i == 4 && j == 3)
+    UTEST(cst && (cst->eps.cmd & eps_skip) && context_lastRow(cxt, cst) == row);
+}
+
 // ----- setup
 
 static T*
@@ -673,6 +791,29 @@ ut_setup6(T *cxt)
   return cxt;
 }
 
+static T*
+ut_setup8(T *cxt)
+{
+  C cst;
+  struct eps eps = eps_init(eps_dig , 8);
+  struct eps skp = eps_init(eps_skip, 8);
+
+  // B+1-B+3    2
+  cst = constraint_init(slice_initSize(BIGROW+1, 3), slice_init(2), eps, -1, 0);
+  cxt = context_add(cxt, &cst);
+  // B+2-$/2    1-3
+  cst = constraint_init(slice_initLastStride(BIGROW+2, ULLONG_MAX, 2), slice_initSize(1, 3), eps, -1, 0);
+  cxt = context_add(cxt, &cst);
+  // B+4        3
+  cst = constraint_init(slice_init(BIGROW+4), slice_init(3), skp, -1, 0);
+  cxt = context_add(cxt, &cst);
+  // 1-$        5
+  cst = constraint_init(slice_initAll(), slice_init(5), eps, -1, 0);
+  cxt = context_add(cxt, &cst);
+
+  return cxt;
+}
+
 static T*
 ut_setup7(T *cxt)
 {
@@ -689,7 +830,7 @@ ut_setup7(T *cxt)
 static struct spec {
   const char *name;
   T*        (*setup)   (T*);
-  void      (*test )   (struct utest*, T*, int, int);
+  void      (*test )   (struct utest*, T*, llong, llong);
   T*        (*teardown)(T*);
 } spec[] = {
   { "no constraint",                        0        , ut_testNul, ut_teardown },
@@ -700,6 +841,7 @@ static struct spec {
   { "overlapping strided constraints",      ut_setup5, ut_testEqu, ut_teardown },
   { "sparse mixed strided constraints",     ut_setup6, ut_testEqu, ut_teardown },
   { "many mixed strided constraints",       ut_setup7, ut_testEqu, ut_teardown },
+  { "rows past 32-bit limits",              ut_setup8, ut_testBig, ut_teardown },
   { "no constraint (after use)",            0        , ut_testNul, ut_teardown }
 };
 enum { spec_n = sizeof spec/sizeof *spec };
@@ -733,4 +875,94 @@ context_utest(struct utest *ut)
   context_free(cxt);
 }
 
+// -----------------------------------------------------------------------------
+// ----- microbenchmarks
+// -----------------------------------------------------------------------------
+
+// per-row rules (perrow shape of ndbench) scanned row by row, column by column
+enum { UB_ROW = 10000, UB_COL = 8, UB_BLK = 10 };
+
+struct ub_state {
+  T  *cxt;
+  int row, col;
+};
+
+static volatile long ub_sink;
+
+static T*
+ub_setup(T *cxt)
+{
+  C cst;
+
+  // *  *  rel=1e-10
+  cst = constraint_init(slice_initAll(), slice_initAll(), eps_init(eps_rel, 1e-10), -1, 0);
+  cxt = context_add(cxt, &cst);
+
+  for (int r = 1; r <= UB_ROW; r += UB_BLK) {
+    // r-r+9  1  rel=1e-9
+    cst = constraint_init(slice_initSize(r, UB_BLK), slice_init(1), eps_init(eps_rel, 1e-9), -1, 0);
+    cxt = context_add(cxt, &cst);
+    // r-r+9  2-$  abs=1e-6
+    cst = constraint_init(slice_initSize(r, UB_BLK), slice_initLast(2, ULLONG_MAX), eps_init(eps_abs, 1e-6), -1, 0);
+    cxt = context_add(cxt, &cst);
+  }
+
+  return cxt;
+}
+
+static inline void
+ub_next(struct ub_state *st)
+{
+  if (++st->col > UB_COL) {
+    st->col = 1;
+    if (++st->row > UB_ROW) st->row = 1, context_teardown(st->cxt); // restart
+  }
+}
+
+static void
+ub_getInc(void *arg, long n)
+{
+  struct ub_state *st = arg;
+  long s = 0;
+
+  for (long k = 0; k < n; k++) {
+    s += context_getInc(st->cxt, st->row, st->col) != 0;
+    ub_next(st);
+  }
+
+  ub_sink = s;
+}
+
+static void
+ub_getAt(void *arg, long n)
+{
+  struct ub_state *st = arg;
+  long s = 0;
+
+  for (long k = 0; k < n; k++) {
+    s += context_getAt(st->cxt, st->row, st->col) != 0;
+    ub_next(st);
+  }
+
+  ub_sink = s;
+}
+
+void
+context_bench(struct utest *ut)
+{
+  assert(ut);
+  struct ub_state st = { ub_setup(context_alloc(0)), 1, 1 };
+
+  utest_title(ut, "Context");
+
+  context_teardown(st.cxt);
+  utest_bench(ut, "context.getInc", ub_getInc, &st);
+
+  st.row = st.col = 1;
+  context_teardown(st.cxt);
+  utest_bench(ut, "context.getAt" , ub_getAt , &st);
+
+  context_free(st.cxt);
+}
+
 #endif
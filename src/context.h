@@ -27,12 +27,19 @@ struct utest;
 struct context;
 struct constraint;
 
+// per-rule profile counters (indexed by rule idx)
+struct context_prof {
+  llong  rows, nums, fails, acts;
+  double time; // estimated from sampled rows (s)
+};
+
 // ----- interface
 
 #define T struct context
 #define C struct constraint
 
 T*       context_alloc  (int n_);
+void     context_reset  (T*); // restart from first row, keep constraints
 void     context_clear  (T*); // reset + erase constraints
 void     context_free   (T*);
 
@@ -43,8 +50,11 @@ T*       context_add     (T*, const C*);
 void     context_onfail  (T*, const C*);
 
 // return 0 if no constraint are found, getInc requires increasing (row,col)
-const C* context_getAt   (T*, int row, int col);
-const C* context_getInc  (T*, int row, int col);
+const C* context_getAt   (T*, llong row, llong col);
+const C* context_getInc  (T*, llong row, llong col);
+
+// return the last row where the action selected by getInc stays selected alone
+llong    context_lastRow (const T*, const C*);
 
 // return the contraint at the index
 const C* context_getIdx  (const T*, int idx);
@@ -53,9 +63,18 @@ int      context_findIdx (const T*, const C*); // -1 for invalid constraint
 // return the line of the contraint
 int      context_findLine(const T*, const C*); // -1 for invalid constraint
 
+// return the memory used by the context (bytes)
+long     context_memsize (const T*);
+
+// enable per-rule counters, return 0 if not enabled
+void     context_profile (T*);
+struct context_prof*
+         context_getProf (T*);
+
 // input/output context of (registered) constraints
 T*       context_scan (      T*, FILE *fp);
 void     context_print(const T*, FILE *fp); // for debug
+void     context_printProf(const T*, FILE *fp);
 
 #undef T
 #undef C
@@ -65,6 +84,7 @@ void     context_print(const T*, FILE *fp); // for debug
 #ifndef NTEST
 
 void context_utest (struct utest*);
+void context_bench (struct utest*);
 
 #endif // NTEST
 #endif
@@ -0,0 +1,286 @@
+/*
+ o---------------------------------------------------------------------o
+ |
+ | Ndiff
+ |
+ | Copyright (c) 2012+ laurent.deniau@cern.ch
+ | Gnu General Public License
+ |
+ o---------------------------------------------------------------------o
+
+   Purpose:
+     accumulate numerical errors per (rule, column) or per TFS column
+     display error tables and suggest tolerances
+
+ o---------------------------------------------------------------------o
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <ctype.h>
+#include <math.h>
+
+#include "error.h"
+#include "errstats.h"
+
+#define T struct errstats
+
+// ----- constants
+
+enum { MAXNAMELEN = 32 };
+
+// ----- types
+
+struct cell {
+  long   cnt, fails;
+  double abs, rel, dig;   // max of |errors|
+  long   hist[errstats_hist];
+};
+
+struct cells {
+  int          n;
+  struct cell *cell;
+};
+
+struct errstats {
+  // per rule, per column
+  struct cells *rule;
+  int           rule_n;
+
+  // per TFS numeric column (after the "$" line)
+  struct cells  tfs;
+  char        (*name)[MAXNAMELEN];
+  int           name_n;
+  llong         tfs_row;
+};
+
+// ----- private
+
+static struct cell*
+cells_get (struct cells *c, int col)
+{
+  if (col >= c->n) {
+    int n = col+1 > 2*c->n ? col+1 : 2*c->n;
+    c->cell = realloc(c->cell, n * sizeof *c->cell);
+    ensure(c->cell, "out of memory");
+    memset(c->cell+c->n, 0, (n - c->n) * sizeof *c->cell);
+    c->n = n;
+  }
+  return c->cell + col;
+}
+
+static void
+cell_add (struct cell *c, double abs, double rel, double dig, bool fail)
+{
+  abs = fabs(abs), rel = fabs(rel), dig = fabs(dig);
+
+  c->cnt   += 1;
+  c->fails += fail;
+  if (c->abs < abs) c->abs = abs;
+  if (c->rel < rel) c->rel = rel;
+  if (c->dig < dig) c->dig = dig;
+
+  int b;
+  if (!(rel > 0)) b = 0;
+  else {
+    b = (int)floor(log10(rel)) - errstats_hmin + 1;
+    if (b < 1) b = 1;
+    if (b > errstats_hist-1) b = errstats_hist-1;
+  }
+  c->hist[b] += 1;
+}
+
+static void
+cell_merge (struct cell *c, const struct cell *c2)
+{
+  c->cnt   += c2->cnt;
+  c->fails += c2->fails;
+  if (c->abs < c2->abs) c->abs = c2->abs;
+  if (c->rel < c2->rel) c->rel = c2->rel;
+  if (c->dig < c2->dig) c->dig = c2->dig;
+  for (int i = 0; i < errstats_hist; i++)
+    c->hist[i] += c2->hist[i];
+}
+
+// round up to one significant digit (tightest passing tolerance)
+static double
+round_up (double x)
+{
+  if (!(x > 0)) return 0;
+  double p = pow(10, floor(log10(x)));
+  return ceil(x/p * (1 - 1e-12)) * p;
+}
+
+static void
+cell_print (const struct cell *c, FILE *fp)
+{
+  fprintf(fp, " %10ld %8ld  %9.2e  %9.2e  %9.2e   abs=%.0e rel=%.0e\n",
+          c->cnt, c->fails, c->abs, c->rel, c->dig, round_up(c->abs), round_up(c->rel));
+
+  // histogram of log10|rel|, non-empty bins only
+  fprintf(fp, "   %16s", "");
+  if (c->hist[0]) fprintf(fp, " 0:%ld", c->hist[0]);
+  for (int i = 1; i < errstats_hist; i++)
+    if (c->hist[i]) {
+      if (i == errstats_hist-1) fprintf(fp, " >=1:%ld", c->hist[i]);
+      else                      fprintf(fp, " 1e%d:%ld", i-1 + errstats_hmin, c->hist[i]);
+    }
+  putc('\n', fp);
+}
+
+static void
+cells_clear (struct cells *c)
+{
+  if (c->n) memset(c->cell, 0, c->n * sizeof *c->cell);
+}
+
+// -----------------------------------------------------------------------------
+// ----- interface
+// -----------------------------------------------------------------------------
+
+T*
+errstats_alloc (void)
+{
+  T *es = calloc(1, sizeof *es);
+  ensure(es, "out of memory");
+  return es;
+}
+
+void
+errstats_free (T *es)
+{
+  if (!es) return;
+
+  for (int i = 0; i < es->rule_n; i++)
+    free(es->rule[i].cell);
+
+  free(es->rule);
+  free(es->tfs.cell);
+  free(es->name);
+  free(es);
+}
+
+void
+errstats_clear (T *es)
+{
+  assert(es);
+
+  for (int i = 0; i < es->rule_n; i++)
+    cells_clear(es->rule+i);
+
+  cells_clear(&es->tfs);
+  es->name_n = es->tfs_row = 0;
+}
+
+void
+errstats_add (T *es, llong row, int rule, llong col, double abs, double rel, double dig, bool fail)
+{
+  assert(es && rule >= 0 && col >= 0);
+
+  if (col > errstats_maxcol) col = errstats_maxcol;
+
+  if (rule >= es->rule_n) {
+    int n = rule+1;
+    es->rule = realloc(es->rule, n * sizeof *es->rule);
+    ensure(es->rule, "out of memory");
+    memset(es->rule+es->rule_n, 0, (n - es->rule_n) * sizeof *es->rule);
+    es->rule_n = n;
+  }
+
+  cell_add(cells_get(es->rule+rule, col), abs, rel, dig, fail);
+
+  if (es->tfs_row && row > es->tfs_row)
+    cell_add(cells_get(&es->tfs, col), abs, rel, dig, fail);
+}
+
+void
+errstats_tfs (T *es, llong row, const char *line)
+{
+  assert(es && line);
+
+  // names
+  if (line[0] == '*' && isblank(line[1])) {
+    int n = 0;
+    for (const char *p = line+1; *p; ) {
+      while (isblank(*p)) p++;
+      if (!*p) break;
+      n++;
+      while (*p && !isblank(*p)) p++;
+    }
+
+    es->name = realloc(es->name, (n+1) * sizeof *es->name);
+    ensure(es->name, "out of memory");
+
+    n = 0;
+    for (const char *p = line+1; *p; ) {
+      while (isblank(*p)) p++;
+      if (!*p) break;
+      int i = 0;
+      while (*p && !isblank(*p)) {
+        if (i < MAXNAMELEN-1) es->name[n][i++] = *p;
+        p++;
+      }
+      es->name[n++][i] = 0;
+    }
+
+    es->name_n  = n;
+    es->tfs_row = 0;
+    return;
+  }
+
+  // types: keep the names of numeric columns only
+  if (line[0] == '$' && isblank(line[1]) && es->name_n) {
+    int i = 0, j = 0;
+    for (const char *p = line+1; *p && i < es->name_n; i++) {
+      while (isblank(*p)) p++;
+      if (!*p) break;
+      bool str = p[0] == '%' && p[strcspn(p, " \t")-1] == 's';
+      if (!str) memmove(es->name[j++], es->name[i], MAXNAMELEN);
+      while (*p && !isblank(*p)) p++;
+    }
+
+    es->name_n  = j;
+    es->tfs_row = row;
+  }
+}
+
+void
+errstats_print (const T *es, FILE *fp, const char *title)
+{
+  assert(es && fp);
+
+  fprintf(fp, " ~ errstats %s\n", title ? title : "");
+  fprintf(fp, "   %-16s %10s %8s  %9s  %9s  %9s   %s\n",
+          "rule:column", "count", "fails", "max|abs|", "max|rel|", "max|dig|", "suggested tolerances");
+
+  for (int r = 0; r < es->rule_n; r++)
+    for (int c = 0; c < es->rule[r].n; c++) {
+      const struct cell *cell = es->rule[r].cell+c;
+      if (!cell->cnt) continue;
+      fprintf(fp, "   #%-6d %-8d", r, c);
+      cell_print(cell, fp);
+    }
+
+  if (!es->tfs_row) return;
+
+  // per TFS column, numeric column c (1-based) maps to name[c-1]
+  fprintf(fp, "   %-16s\n", "tfs column:");
+  for (int c = 1; c < es->tfs.n && c <= es->name_n; c++) {
+    if (!es->tfs.cell[c].cnt) continue;
+    fprintf(fp, "   %-16.16s", es->name[c-1]);
+    cell_print(es->tfs.cell+c, fp);
+  }
+
+  // merge columns beyond the names (e.g. numbers inside strings)
+  struct cell extra = { 0 };
+  for (int c = es->name_n+1; c < es->tfs.n; c++)
+    cell_merge(&extra, es->tfs.cell+c);
+
+  if (extra.cnt) {
+    fprintf(fp, "   %-16s", "(extra)");
+    cell_print(&extra, fp);
+  }
+}
+
+#undef T
@@ -0,0 +1,55 @@
+#ifndef ERRSTATS_H
+#define ERRSTATS_H
+
+/*
+ o---------------------------------------------------------------------o
+ |
+ | Ndiff
+ |
+ | Copyright (c) 2012+ laurent.deniau@cern.ch
+ | Gnu General Public License
+ |
+ o---------------------------------------------------------------------o
+
+   Purpose:
+     accumulate numerical errors per (rule, column) or per TFS column
+     display error tables and suggest tolerances
+
+ o---------------------------------------------------------------------o
+*/
+
+#include <stdio.h>
+#include "types.h"
+
+// ----- constants
+
+// log10 histogram of |rel|: zero, [1e-18,1e-17[ ... [1e-1,1e0[, >= 1
+enum { errstats_hmin = -18, errstats_hmax = 0,
+       errstats_hist = errstats_hmax - errstats_hmin + 2 };
+
+// columns beyond this bound are accumulated into the last one
+enum { errstats_maxcol = 1 << 16 };
+
+// ----- types
+
+struct errstats;
+
+// ----- interface
+
+#define T struct errstats
+
+T*   errstats_alloc (void);
+void errstats_free  (T*);
+void errstats_clear (T*);
+
+// record the errors of one comparison
+void errstats_add   (T*, llong row, int rule, llong col, double abs, double rel, double dig, bool fail);
+
+// scan TFS header lines ("* names" and "$ types") to name numeric columns
+void errstats_tfs   (T*, llong row, const char *line);
+
+void errstats_print (const T*, FILE*, const char *title);
+
+#undef T
+
+#endif
@@ -0,0 +1,131 @@
+/*
+ o---------------------------------------------------------------------o
+ |
+ | Ndiff
+ |
+ | Copyright (c) 2012+ laurent.deniau@cern.ch
+ | Gnu General Public License
+ |
+ o---------------------------------------------------------------------o
+
+   Purpose:
+     record the last trace events into a ring of binary records
+     decode and display the recent events on demand (flight recorder)
+
+ o---------------------------------------------------------------------o
+*/
+
+#include <stdlib.h>
+#include <assert.h>
+
+#include "error.h"
+#include "flight.h"
+#include "constraint.h"
+
+#define T struct flight
+
+// ----- private
+
+static const char *kind_str[flight_kind_n] = {
+  "line", "skip", "goto", "rule", "num", "str", "test"
+};
+
+static void
+flight_print (const struct flight_rec *r, long seq, FILE *fp)
+{
+  fprintf(fp, "   #%-8ld %-4s line %lld", seq, kind_str[r->kind], r->row);
+
+  switch (r->kind) {
+  case flight_line:
+  case flight_skip:
+    break;
+
+  case flight_goto:
+    fprintf(fp, " (%+lld|%+lld)%s", r->lhs_i, r->rhs_i, r->flags ? " not found" : "");
+    break;
+
+  case flight_rule:
+    fprintf(fp, " rule #%d (line %d)", r->rule, r->line);
+    break;
+
+  case flight_num:
+    fprintf(fp, " column %lld char-columns %lld|%lld", r->col, r->lhs_i+1, r->rhs_i+1);
+    break;
+
+  case flight_str:
+    fprintf(fp, " char-columns %lld|%lld rule #%d (line %d)%s", r->lhs_i, r->rhs_i,
+            r->rule, r->line, r->flags ? " differ" : "");
+    break;
+
+  case flight_test:
+    fprintf(fp, " column %lld char-columns %lld|%lld rule #%d (line %d) %.17g|%.17g",
+            r->col, r->lhs_i+1, r->rhs_i+1, r->rule, r->line, r->lhs, r->rhs);
+    if (r->flags)
+      fprintf(fp, " failed%s%s%s%s%s",
+              r->flags & eps_ign ? " ign" : "", r->flags & eps_equ ? " equ" : "",
+              r->flags & eps_abs ? " abs" : "", r->flags & eps_rel ? " rel" : "",
+              r->flags & eps_dig ? " dig" : "");
+    break;
+  }
+
+  putc('\n', fp);
+}
+
+// -----------------------------------------------------------------------------
+// ----- interface
+// -----------------------------------------------------------------------------
+
+T*
+flight_alloc (long n)
+{
+  ensure(n > 0, "invalid flight recorder size");
+
+  long sz = 1;
+  while (sz < n) sz *= 2;
+
+  T *fr = malloc(sizeof *fr);
+  ensure(fr, "out of memory");
+
+  fr->rec = malloc(sz * sizeof *fr->rec);
+  ensure(fr->rec, "out of memory");
+
+  fr->mask = sz-1;
+  flight_clear(fr);
+
+  return fr;
+}
+
+void
+flight_free (T *fr)
+{
+  if (!fr) return;
+  free(fr->rec);
+  free(fr);
+}
+
+void
+flight_clear (T *fr)
+{
+  assert(fr);
+  fr->pos = fr->dumped = 0;
+}
+
+void
+flight_dump (T *fr, FILE *fp)
+{
+  assert(fr && fp);
+
+  long beg = fr->dumped, end = fr->pos;
+  if (end - beg > fr->mask+1) beg = end - (fr->mask+1);
+  if (beg == end) return;
+
+  fflush(stdout);
+  fprintf(fp, " ~ flight recorder: last %ld of %ld events\n", end-beg, end);
+
+  for (long i = beg; i < end; i++)
+    flight_print(fr->rec + (i & fr->mask), i+1, fp);
+
+  fr->dumped = end;
+}
+
+#undef T
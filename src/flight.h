@@ -0,0 +1,76 @@
+#ifndef FLIGHT_H
+#define FLIGHT_H
+
+/*
+ o---------------------------------------------------------------------o
+ |
+ | Ndiff
+ |
+ | Copyright (c) 2012+ laurent.deniau@cern.ch
+ | Gnu General Public License
+ |
+ o---------------------------------------------------------------------o
+
+   Purpose:
+     record the last trace events into a ring of binary records
+     decode and display the recent events on demand (flight recorder)
+
+ o---------------------------------------------------------------------o
+*/
+
+#include <stdio.h>
+#include "types.h"
+
+// ----- constants
+
+enum flight_kind {
+  flight_line,  // readLine
+  flight_skip,  // skipLine
+  flight_goto,  // gotoLine, gotoNum (lhs_i|rhs_i hold the lines read, flags a tag not found)
+  flight_rule,  // rule activation (action)
+  flight_num,   // nextNum found numbers
+  flight_str,   // nextNum found different strings
+  flight_test,  // testNum (flags hold the failed checks)
+
+  flight_kind_n
+};
+
+// ----- types
+
+struct flight_rec {
+  llong  row, col;
+  llong  lhs_i, rhs_i; // char-columns
+  int    rule, line;   // rule index and line in config file
+  uint   flags;
+  uint   kind;
+  double lhs, rhs;
+};
+
+struct flight {
+  struct flight_rec *rec;
+  long   mask;         // capacity - 1 (power of 2)
+  long   pos, dumped;  // number of events recorded, at last dump
+};
+
+// ----- interface
+
+#define T struct flight
+
+T*   flight_alloc (long n); // capacity rounded up to a power of 2
+void flight_free  (T*);
+void flight_clear (T*);
+
+// decode and print the events recorded since the last dump
+void flight_dump  (T*, FILE*);
+
+static inline void
+flight_put (T *fr, enum flight_kind kind, llong row, llong col, llong lhs_i, llong rhs_i,
+            int rule, int line, uint flags, double lhs, double rhs)
+{
+  struct flight_rec *r = fr->rec + (fr->pos++ & fr->mask);
+  *r = (struct flight_rec) { row, col, lhs_i, rhs_i, rule, line, flags, kind, lhs, rhs };
+}
+
+#undef T
+
+#endif
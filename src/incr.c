@@ -0,0 +1,262 @@
+/*
+ o---------------------------------------------------------------------o
+ |
+ | Ndiff
+ |
+ | Copyright (c) 2012+ laurent.deniau@cern.ch
+ | Gnu General Public License
+ |
+ o---------------------------------------------------------------------o
+
+   Purpose:
+     block digests and outcomes of a diff for incremental re-diffs
+     load the blocks of the previous run, save the blocks of this run
+
+ o---------------------------------------------------------------------o
+*/
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "error.h"
+#include "incr.h"
+#include "register.h"
+
+#ifdef _WIN32
+#define ftello(fp)          _ftelli64(fp)
+#define fseeko(fp, o, w)    _fseeki64(fp, o, w)
+#endif
+
+#define T struct incr
+
+// ----- constants
+
+enum { INCRBUFSIZ = 65536 };
+
+// ----- types
+
+struct blks {
+  struct incr_blk *dat;
+  long n, max;
+};
+
+struct incr {
+  ullong key;
+  struct blks old, new; // blocks of the previous run and of this run
+  long   cur;           // search position in old blocks
+  llong  reused;        // rows reused
+};
+
+// ----- private
+
+static void
+incr_push (struct blks *b, const struct incr_blk *blk)
+{
+  if (b->n == b->max) {
+    b->max = b->max ? 2*b->max : 64;
+    b->dat = realloc(b->dat, b->max * sizeof *b->dat);
+    ensure(b->dat, "out of memory");
+  }
+
+  struct incr_blk *d = &b->dat[b->n++];
+  *d = *blk;
+  d->reg = malloc(d->reg_n * sizeof *d->reg);
+  ensure(d->reg, "out of memory");
+  memcpy(d->reg, blk->reg, d->reg_n * sizeof *d->reg);
+}
+
+static void
+incr_clear (struct blks *b)
+{
+  for (long i = 0; i < b->n; i++) free(b->dat[i].reg);
+  b->n = 0;
+}
+
+// parse one block, registers are listed by index after the fields
+static bool
+incr_parse (FILE *fp, struct incr_blk *blk, double *reg)
+{
+  int clean, c;
+
+  if (fscanf(fp, "%lld %lld %lld %d %lld %llx %lld %llx %llx %d", &blk->row, &blk->rows, &blk->nums,
+             &clean, &blk->lhs_n, &blk->lhs_h, &blk->rhs_n, &blk->rhs_h, &blk->cxt_h, &blk->reg_n) != 10 ||
+      blk->reg_n <= 0 || blk->reg_n > REG_MAX)
+    return false;
+
+  blk->clean = clean != 0;
+  blk->reg   = reg;
+  memset(reg, 0, blk->reg_n * sizeof *reg);
+
+  while ((c = getc(fp)) == ' ') {
+    int    i;
+    ullong bits;
+    if (fscanf(fp, "%d:%llx", &i, &bits) != 2 || i < 0 || i >= blk->reg_n) return false;
+    memcpy(reg+i, &bits, sizeof bits);
+  }
+
+  return c == '\n';
+}
+
+// -----------------------------------------------------------------------------
+// ----- interface
+// -----------------------------------------------------------------------------
+
+T*
+incr_alloc (ullong key)
+{
+  T *inc = calloc(1, sizeof *inc);
+  ensure(inc, "out of memory");
+
+  inc->key = key;
+
+  return inc;
+}
+
+void
+incr_free (T *inc)
+{
+  if (!inc) return;
+
+  incr_clear(&inc->old);
+  incr_clear(&inc->new);
+  free(inc->old.dat);
+  free(inc->new.dat);
+  free(inc);
+}
+
+bool
+incr_load (T *inc, FILE *fp)
+{
+  assert(inc && fp);
+
+  double *reg = malloc(REG_MAX * sizeof *reg);
+  ensure(reg, "out of memory");
+
+  struct incr_blk blk;
+  int    ver, c;
+  ullong key;
+  bool   ok = fscanf(fp, "ndiff-incr %d %llx", &ver, &key) == 2 && (c = getc(fp)) == '\n' &&
+              ver == incr_version && key == inc->key;
+
+  incr_clear(&inc->old);
+  inc->cur = 0;
+
+  while (ok && (c = getc(fp)) != EOF) {
+    ungetc(c, fp);
+    if (!(ok = incr_parse(fp, &blk, reg))) break;
+    incr_push(&inc->old, &blk);
+  }
+
+  // partial or foreign digests are useless
+  if (!ok) incr_clear(&inc->old);
+
+  free(reg);
+
+  return ok;
+}
+
+void
+incr_save (const T *inc, FILE *fp)
+{
+  assert(inc && fp);
+
+  fprintf(fp, "ndiff-incr %d %016llx\n", incr_version, inc->key);
+
+  for (long i = 0; i < inc->new.n; i++) {
+    const struct incr_blk *b = &inc->new.dat[i];
+
+    fprintf(fp, "%lld %lld %lld %d %lld %016llx %lld %016llx %016llx %d", b->row, b->rows, b->nums,
+            b->clean, b->lhs_n, b->lhs_h, b->rhs_n, b->rhs_h, b->cxt_h, b->reg_n);
+
+    for (int r = 0; r < b->reg_n; r++) {
+      ullong bits;
+      memcpy(&bits, b->reg+r, sizeof bits);
+      if (bits) fprintf(fp, " %d:%llx", r, bits);
+    }
+
+    putc('\n', fp);
+  }
+}
+
+const struct incr_blk*
+incr_find (T *inc, llong row)
+{
+  assert(inc);
+
+  while (inc->cur < inc->old.n && inc->old.dat[inc->cur].row < row) inc->cur++;
+
+  return inc->cur < inc->old.n && inc->old.dat[inc->cur].row == row ? &inc->old.dat[inc->cur] : 0;
+}
+
+const struct incr_blk*
+incr_next (const T *inc, const struct incr_blk *blk)
+{
+  assert(inc && blk);
+
+  const struct incr_blk *nxt = blk+1;
+
+  return nxt < inc->old.dat+inc->old.n && nxt->row == blk->row+blk->rows ? nxt : 0;
+}
+
+void
+incr_add (T *inc, const struct incr_blk *blk, bool reused)
+{
+  assert(inc && blk);
+
+  incr_push(&inc->new, blk);
+  if (reused) inc->reused += blk->rows;
+}
+
+void
+incr_getInfo (const T *inc, llong *blocks_, llong *reused_)
+{
+  assert(inc);
+
+  if (blocks_) *blocks_ = inc->new.n;
+  if (reused_) *reused_ = inc->reused;
+}
+
+ullong
+incr_hash (ullong h, const void *buf, size_t n)
+{
+  const unsigned char *p = buf;
+  ullong w;
+
+  // word-wise multiply-xorshift, byte-wise tail
+  for (; n >= sizeof w; p += sizeof w, n -= sizeof w) {
+    memcpy(&w, p, sizeof w);
+    h = (h ^ w) * 0x9e3779b97f4a7c15ULL;
+    h ^= h >> 29;
+  }
+
+  for (; n > 0; p++, n--)
+    h = (h ^ *p) * 0x100000001b3ULL;
+
+  return h;
+}
+
+ullong
+incr_digest (FILE *fp, llong off, llong n)
+{
+  static char buf[INCRBUFSIZ];
+  llong  pos = ftello(fp), cnt = 0;
+  ullong h = 0xcbf29ce484222325ULL;
+  size_t k;
+
+  assert(fp && off >= 0 && n >= 0);
+
+  ensure(pos >= 0 && !fseeko(fp, off, SEEK_SET), "unable to seek input file");
+
+  // the next byte ends the last line (\r\n) or tells the end of file
+  for (n += 1; n > 0 && (k = fread(buf, 1, n < INCRBUFSIZ ? n : INCRBUFSIZ, fp)) > 0; n -= k)
+    h = incr_hash(h, buf, k), cnt += k;
+
+  ensure(!fseeko(fp, pos, SEEK_SET), "unable to seek input file");
+
+  return incr_hash(h, &cnt, sizeof cnt);
+}
+
+#undef T
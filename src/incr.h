@@ -0,0 +1,74 @@
+#ifndef INCR_H
+#define INCR_H
+
+/*
+ o---------------------------------------------------------------------o
+ |
+ | Ndiff
+ |
+ | Copyright (c) 2012+ laurent.deniau@cern.ch
+ | Gnu General Public License
+ |
+ o---------------------------------------------------------------------o
+
+   Purpose:
+     block digests and outcomes of a diff for incremental re-diffs
+     load the blocks of the previous run, save the blocks of this run
+
+   Text format (one block per line after the header):
+     header: "ndiff-incr" version key(hex)
+     block : row rows nums clean lhs_n lhs_h(hex) rhs_n rhs_h(hex) cxt_h(hex) reg_n [idx:bits(hex) ...]
+     only the registers with non-zero bits are listed
+
+ o---------------------------------------------------------------------o
+*/
+
+#include <stdio.h>
+#include "types.h"
+
+// ----- constants
+
+enum { incr_version = 2 };
+
+// ----- types
+
+struct incr;
+
+struct incr_blk {
+  llong   row, rows;    // rows diffed before the block, rows of the block
+  llong   nums;         // numbers checked in the block
+  llong   lhs_n, rhs_n; // bytes of the block
+  ullong  lhs_h, rhs_h; // digests of the bytes and of the next one
+  ullong  cxt_h;        // digest of the rules state (alt) at the beginning of the block
+  bool    clean;        // no diff detected, outcome reusable
+  int     reg_n;
+  double *reg;          // registers at the beginning of the block
+};
+
+// ----- interface
+
+#define T struct incr
+
+// key: digest of everything but the input files that drives the diff (rules, options)
+T*     incr_alloc  (ullong key);
+void   incr_free   (T*);
+
+// previous blocks, discarded if the key or the version differ
+bool   incr_load   (T*, FILE*);
+void   incr_save   (const T*, FILE*);
+
+// previous block starting after row (rows must increase), the block following it
+const struct incr_blk* incr_find (T*, llong row);
+const struct incr_blk* incr_next (const T*, const struct incr_blk*);
+
+// append a block of this run, reused from the previous run or diffed
+void   incr_add    (T*, const struct incr_blk*, bool reused);
+void   incr_getInfo(const T*, llong *blocks_, llong *reused_); // reused rows
+
+// digest of n bytes at off and of the byte following them, keep the stream position
+ullong incr_digest (FILE*, llong off, llong n);
+ullong incr_hash   (ullong h, const void *buf, size_t n);
+
+#undef T
+
+#endif
@@ -14,6 +14,8 @@
  o---------------------------------------------------------------------o
 */
 
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
@@ -25,12 +27,29 @@
 #include "ndiff.h"
 #include "context.h"
 #include "constraint.h"
+#include "stats.h"
+#include "flight.h"
+#include "report.h"
+#include "errstats.h"
+#include "watch.h"
+#include "tree.h"
+#include "shard.h"
+#include "incr.h"
+
+// rows diffed in the region of rows (--rows), if any
+static llong
+diff_region(llong row)
+{
+  if (option.rows_f <= 1) return row;
+  return row >= option.rows_f ? row - option.rows_f + 1 : 0;
+}
 
-static int
+static llong
 diff_summary(const struct ndiff *dif)
 {
-  int n, c;
+  llong n, c;
   ndiff_getInfo(dif, &n, 0, &c, 0);
+  n = diff_region(n);
 
   if (!ndiff_feof(dif, 1) && !option.trunc) {
     c += 1;
@@ -40,12 +59,20 @@ diff_summary(const struct ndiff *dif)
   if (c) {
 //    if (option.test)
 //    warning("(*) files '%s'|'%s' from test '%s' differ", option.lhs_file, option.rhs_file, option.test);
-    warning("(=) % 6d lines have been diffed", n);
-    warning("(=) % 6d diffs have been detected", c);
+    warning("(=) % 6lld lines have been diffed", n);
+    warning("(=) % 6lld diffs have been detected", c);
   } else {
     if (option.test)
     inform ("files '%s'|'%s' from test '%s' do not differ", option.lhs_file, option.rhs_file, option.test);
-    inform ("% 6d lines have been diffed", n);
+    inform ("% 6lld lines have been diffed", n);
+  }
+
+  if (option.sample && option.sample < 1) {
+    llong r, s;
+    ndiff_getSample(dif, &r, &s);
+    double cov = r ? 100.0*(r-s)/r : 100.0;
+    if (c) warning("(=) % 6lld of %lld rows sampled (%.1f%% coverage)", r-s, r, cov);
+    else   inform ("% 6lld of %lld rows sampled (%.1f%% coverage)", r-s, r, cov);
   }
 
   return c;
@@ -59,8 +86,47 @@ test_summary(int total, int failed)
           failed ? fail_str : pass_str);
 }
 
+// statistics
+static struct stats *pair_sta, *suite_sta;
+static struct perf  *pmu;
+static struct flight *flight;
+static struct report *report;
+static struct errstats *errstats;
+static struct shard *shard;
+
+static void
+rprof_summary(const struct context *cxt)
+{
+  static FILE *fp;
+
+  if (!fp) {
+    fp = fopen(option.rprof, "w");
+    ensure(fp, "failed to create rule profile file %s", option.rprof);
+  }
+
+  fprintf(fp, "# '%s'|'%s'", option.lhs_file, option.rhs_file);
+  if (option.test) fprintf(fp, " from test '%s'", option.test);
+  fprintf(fp, " with rules '%s'\n", option.cfg_file);
+
+  context_printProf(cxt, fp);
+  fflush(fp);
+}
+
 static void
-check_transition(const char* argv[], int *total, int *failed, long lines, long numbers)
+stats_summary(void)
+{
+  if (!suite_sta) return;
+
+  char title[FILENAME_MAX+32];
+  sprintf(title, "test '%.*s'", FILENAME_MAX, option.test ? option.test : "");
+
+  fflush(stdout);
+  stats_print(suite_sta, stderr, option.test ? title : "total");
+  stats_clear(suite_sta);
+}
+
+static void
+check_transition(const char* argv[], int *total, int *failed, llong lines, llong numbers)
 {
   if (is_option(argv[option.argi]) && option.test && *total && (
       (!strcmp(argv[option.argi], "-t") && !option.lgopt) || !strcmp(argv[option.argi], "--test" ) ||
@@ -71,10 +137,11 @@ check_transition(const char* argv[], int *total, int *failed, long lines, long n
 
     // test stats
     test_summary(*total, *failed);
+    stats_summary();
 
     // suites stats
     if (option.accum)
-      accum_summary(*total, *failed, lines, numbers);
+      accum_append(*total, *failed, lines, numbers);
 
     // cleanup
     *total = *failed = 0;
@@ -86,20 +153,451 @@ check_transition(const char* argv[], int *total, int *failed, long lines, long n
 
 // counters
 static int  total, failed;
-static long lines, numbers;
+static llong lines, numbers;
 
 void
 quit(int exit_code)
 {
-  if (option.test)
+  // tree worker, the caller process reports
+  if (tree_worker()) exit(exit_code);
+
+  // tests entirely assigned to other shards are silent
+  if (option.test && (total || failed || !shard))
     test_summary(total, failed);
 
+  stats_summary();
+
+  if (flight && exit_code != EXIT_SUCCESS)
+    flight_dump(flight, stderr);
+
+  report_free(report);
+  errstats_free(errstats);
+
   if (option.accum)
-    accum_summary(total, failed, lines, numbers);
+    accum_append(total, failed, lines, numbers);
 
   exit(exit_code);
 }
 
+// against mode, the reference is read (and decompressed) once into memory,
+// each output reopens it from there, also in the worker processes (shared pages)
+static struct {
+  char  *buf;
+  size_t len;
+  char   file[FILENAME_MAX];
+} against;
+
+static void
+against_load(const char *rhs_s)
+{
+  int n = 0;
+  size_t k, max = 1 << 20;
+
+  FILE *fp = open_file(rhs_s, 0, &n, option.ref_e, 1, 1);
+
+  against.buf = malloc(max);
+  ensure(against.buf, "out of memory");
+
+  while ((k = fread(against.buf+against.len, 1, max-against.len, fp)) > 0)
+    if ((against.len += k) == max) {
+      against.buf = realloc(against.buf, max *= 2);
+      ensure(against.buf, "out of memory");
+    }
+
+  strcpy(against.file, option.rhs_file);
+  close_file(fp, option.rhs_zip);
+
+  debug("reference '%s' loaded (%zu bytes)", against.file, against.len);
+}
+
+static FILE*
+against_open(void)
+{
+  FILE *fp = 0;
+
+  strcpy(option.rhs_file, against.file);
+  option.rhs_zip = 0;
+
+#ifndef _WIN32
+  if (against.len) fp = fmemopen(against.buf, against.len, "r");
+#endif
+
+  // empty reference or no memory stream
+  if (!fp && (fp = tmpfile())) {
+    ensure(fwrite(against.buf, 1, against.len, fp) == against.len, "unable to write temporary file");
+    rewind(fp);
+  }
+
+  ensure(fp, "unable to reopen reference file '%s'", against.file);
+  return fp;
+}
+
+static void
+against_summary(const struct ndiff *dif)
+{
+  llong n, c;
+  ndiff_getInfo(dif, &n, 0, &c, 0);
+  n = diff_region(n);
+  if (!ndiff_feof(dif, 1) && !option.trunc) c += 1;
+
+  printf(" + %-50s %9lld lines %6lld diffs : %s\n", option.lhs_file, n, c, c ? fail_str : pass_str);
+}
+
+// rediff each time the output file is rewritten, the reference (cached),
+// the rules and the buffers stay resident
+static void
+watch_diff(struct ndiff *dif, struct context *cxt, FILE **lhs_fp, FILE *rhs_fp)
+{
+  struct watch *w = watch_alloc(option.lhs_file);
+  ndiff_result(dif, 0, 0);
+
+  inform("watching '%s' (interrupt to stop)", option.lhs_file);
+
+  while (watch_wait(w)) {
+    FILE *fp = fopen(option.lhs_file, "r");
+    if (!fp) { warning("unable to reopen output file '%s'", option.lhs_file); continue; }
+
+    fclose(*lhs_fp);
+    *lhs_fp = fp;
+
+    rewind(rhs_fp);
+    context_reset(cxt);
+    ndiff_reset(dif, *lhs_fp, rhs_fp);
+
+    inform("processing '%s'|'%s'", option.lhs_file, option.rhs_file);
+    ndiff_loop(dif);
+    diff_summary(dif);
+
+    if (report) report_flush(report);
+    fflush(stdout);
+  }
+
+  warning("watching '%s' stopped", option.lhs_file);
+  watch_free(w);
+}
+
+// incremental mode, blocks of the previous run of the pair (output file.incr),
+// keyed by the rules and the options that drive the diff
+static struct incr*
+diff_incrLoad (int res)
+{
+  char buf[65536];
+  FILE *fp;
+
+  if (res || option.flight || option.errstats || option.rprof || option.sample || option.watch ||
+      option.rows_f || option.cols_f) {
+    warning("incremental mode ignored with result files, flight recorder, error statistics, "
+            "rule profile, sampling, watch mode or regions");
+    return 0;
+  }
+
+  int n = snprintf(buf, sizeof buf, "%d %d %lld '%s' '%s'", option.nregs, option.window,
+                   option.within, option.cchr, option.pchr);
+  ullong key = incr_hash(0, buf, n);
+
+  if (*option.cfg_file && (fp = fopen(option.cfg_file, "rb"))) {
+    size_t k;
+    while ((k = fread(buf, 1, sizeof buf, fp)) > 0) key = incr_hash(key, buf, k);
+    fclose(fp);
+  }
+
+  struct incr *inc = incr_alloc(key);
+
+  snprintf(buf, sizeof buf, "%s.incr", option.lhs_file);
+  if ((fp = fopen(buf, "r"))) {
+    if (!incr_load(inc, fp)) debug("incremental digests '%s' out of date, full diff", buf);
+    fclose(fp);
+  }
+
+  return inc;
+}
+
+// replace the blocks of the previous run, unless none were recorded (slow loop)
+static void
+diff_incrSave (struct incr *inc)
+{
+  char file[FILENAME_MAX+8], tmp[FILENAME_MAX+16];
+  llong blocks, reused;
+
+  incr_getInfo(inc, &blocks, &reused);
+
+  if (blocks) {
+    snprintf(file, sizeof file, "%s.incr", option.lhs_file);
+    snprintf(tmp , sizeof tmp , "%s.tmp" , file);
+
+    FILE *fp = fopen(tmp, "w");
+    bool  ok = fp != 0;
+
+    if (fp) {
+      incr_save(inc, fp);
+      ok = !ferror(fp);
+      ok = !fclose(fp) && ok && !rename(tmp, file);
+      if (!ok) remove(tmp);
+    }
+
+    if (!ok) warning("unable to write incremental digests '%s'", file);
+    inform("% 6lld rows reused from '%s'", reused, file);
+  }
+
+  incr_free(inc);
+}
+
+// diff one pair of files (serie index n), return 0 if the pair was skipped
+static int
+diff_pair(const char *lhs_s, const char *rhs_s, const char *cfg_s, int *n)
+{
+  FILE *lhs_fp=0, *rhs_fp=0, *cfg_fp=0, *lhs_rfp=0, *rhs_rfp=0;
+  int nn = *n;
+
+  // clean filenames
+  *option.lhs_file = *option.rhs_file = *option.cfg_file = 0;
+   option.lhs_zip  =  option.rhs_zip  =  option.cfg_zip  = 0;
+
+  // open files
+  lhs_fp = open_file(lhs_s, option.lhs_res ? &lhs_rfp : 0, &nn, option.out_e, 1, 0);
+  if (!lhs_fp && *n) return 0; // end of serie
+  rhs_fp = option.against ? against_open() :
+           open_file(rhs_s, option.rhs_res ? &rhs_rfp : 0, &nn, option.ref_e, !option.list, !option.list);
+  cfg_fp = open_file(cfg_s,                             0, &nn, option.cfg_e, !option.list, 0);
+  if (*n != nn) { *n = nn; --total; }
+
+  if (!lhs_fp) {
+    if (option.list || option.against) {
+      warning("output file '%s[.out]' not found, skipping diff", lhs_s);
+      close_file(rhs_fp, option.rhs_zip);
+      close_file(cfg_fp, option.cfg_zip);
+      close_file(rhs_rfp, 0);
+      ++total, ++failed;
+      return 0;
+    } else
+      invalid_file(lhs_s);
+  }
+
+  if (!rhs_fp) {
+    if (option.list) {
+      warning("reference file '%s.ref' not found, skipping diff", rhs_s);
+      close_file(lhs_fp, option.lhs_zip);
+      close_file(cfg_fp, option.cfg_zip);
+      close_file(lhs_rfp, 0);
+      ++total, ++failed;
+      return 0;
+    } else
+      invalid_file(rhs_s);
+  }
+
+  // watch mode, cache the (decompressed) reference
+  if (option.watch) {
+    ensure(!option.lhs_zip, "watch mode requires an uncompressed output file '%s'", option.lhs_file);
+    FILE *fp = watch_load(rhs_fp);
+    close_file(rhs_fp, option.rhs_zip);
+    rhs_fp = fp, option.rhs_zip = 0;
+  }
+
+  inform("processing '%s'|'%s'", option.lhs_file, option.rhs_file);
+
+  if (option.canon && !lhs_rfp && !rhs_rfp)
+    warning("canonical filter mode without result file (--lhsres or --rhsres)");
+
+  // create context of constraints (using default size)
+  struct context *cxt = context_alloc(0);
+
+  // load constraints
+  if (cfg_fp) cxt = context_scan(cxt, cfg_fp);
+
+  // enable rules profile
+  if (option.rprof) context_profile(cxt);
+
+  // show constraints
+  if (option.debug) {
+    debug("rules list:");
+    context_print(cxt, stderr);
+  }
+
+  // statistics
+  if (option.stats && !pair_sta) {
+    pair_sta  = stats_alloc();
+    suite_sta = stats_alloc();
+    if (option.perf && !(pmu = perf_alloc()))
+      warning("hardware performance counters unavailable, --perf ignored");
+    stats_perf(pair_sta, pmu);
+  }
+  if (option.stats) {
+    stats_clear(pair_sta);
+    stats_start(pair_sta);
+  }
+
+  // ndiff loop
+  struct ndiff *dif = ndiff_alloc(lhs_fp, rhs_fp, cxt, 0, option.nregs);
+  ndiff_option(dif, &option.keep, &option.blank, &option.check, &option.recycle);
+  ndiff_window(dif, option.window);
+  ndiff_within(dif, option.within);
+  ndiff_async (dif, option.async);
+  if (option.sample) ndiff_sample(dif, option.sample, option.sample_seed);
+  if (option.rows_f) ndiff_rows(dif, option.rows_f, option.rows_l);
+  if (option.cols_f) ndiff_cols(dif, option.cols_f, option.cols_l);
+  ndiff_result(dif, lhs_rfp, rhs_rfp);
+  ndiff_canon (dif, option.canon);
+  ndiff_stats (dif, option.stats ? pair_sta : 0);
+
+  // flight recorder
+  if (option.flight) {
+    if (!flight) flight = flight_alloc(option.flight);
+    flight_clear(flight);
+  }
+  ndiff_flight(dif, option.flight ? flight : 0);
+
+  // diff report
+  if (option.report && !report)
+    report = report_alloc(option.report, option.repfmt);
+  ndiff_report(dif, report);
+
+  // error statistics
+  if (option.errstats) {
+    if (!errstats) errstats = errstats_alloc();
+    errstats_clear(errstats);
+  }
+  ndiff_errstats(dif, option.errstats ? errstats : 0);
+
+  // incremental mode
+  struct incr *inc = option.incr ? diff_incrLoad(lhs_rfp || rhs_rfp) : 0;
+  ndiff_incr(dif, inc, 0);
+
+  ndiff_loop(dif);
+
+  if (inc) diff_incrSave(inc);
+
+  // print summary
+  if (diff_summary(dif) > 0) ++failed;
+  if (option.against) against_summary(dif);
+
+  // collect stats
+  { llong row, num;
+    ndiff_getInfo(dif, &row, 0, 0, &num);
+    lines += diff_region(option.rows_l ? row : row-1); numbers += num;
+  }
+
+  // dump rules profile
+  if (option.rprof) rprof_summary(cxt);
+
+  // flush report
+  if (report) report_flush(report);
+
+  // dump error statistics
+  if (option.errstats) {
+    char title[2*FILENAME_MAX+8];
+    snprintf(title, sizeof title, "'%s'|'%s'", option.lhs_file, option.rhs_file);
+    fflush(stdout);
+    errstats_print(errstats, stderr, title);
+  }
+
+  // watch mode, rediff on rewrite
+  if (option.watch) watch_diff(dif, cxt, &lhs_fp, rhs_fp);
+
+  // destroy components
+  if (option.stats)
+    pair_sta->cxt_mem = context_memsize(cxt);
+  ndiff_free(dif);
+  context_free(cxt);
+
+  // close files
+  close_file(lhs_fp, option.lhs_zip);
+  close_file(rhs_fp, option.rhs_zip);
+  close_file(cfg_fp, option.cfg_zip);
+  close_file(lhs_rfp, 0);
+  close_file(rhs_rfp, 0);
+
+  // print statistics (after unzip completion)
+  if (option.stats) {
+    char title[2*FILENAME_MAX+8];
+    sprintf(title, "'%s'|'%s'", option.lhs_file, option.rhs_file);
+    stats_stop(pair_sta);
+    fflush(stdout);
+    stats_print(pair_sta, stderr, title);
+    stats_add(suite_sta, pair_sta);
+  }
+
+  return 1;
+}
+
+// diff one pair of a tree, the counters are returned instead of accumulated
+static void
+tree_pair(const char *lhs_s, const char *rhs_s, const char *cfg_s, struct tree_res *res)
+{
+  int   t = total, f = failed;
+  llong l = lines, m = numbers;
+  int   n = 0;
+
+  res->total   = diff_pair(lhs_s, rhs_s, cfg_s, &n) + total - t;
+  res->failed  = failed  - f;
+  res->lines   = lines   - l;
+  res->numbers = numbers - m;
+
+  total = t, failed = f, lines = l, numbers = m;
+}
+
+static void
+tree_diff(const char *lhs_s, const char *rhs_s, const char *cfg_s)
+{
+  struct tree_res res = { 0 };
+  int jobs = option.jobs;
+
+  ensure(!option.serie && !option.list && !option.watch && !option.against,
+         "tree mode is exclusive with serie, list, watch and against modes");
+
+  // shared output files are written by one process
+  if (jobs != 1 && (option.report || option.rprof)) {
+    warning("--report and --rule-profile serialize tree mode (--jobs 1)");
+    jobs = 1;
+  }
+
+  struct tree *tree = tree_alloc(lhs_s, rhs_s, cfg_s);
+  if (shard) tree_shard(tree, shard);
+  tree_run(tree, jobs, tree_pair, &res);
+  tree_free(tree);
+
+  total += res.total, failed  += res.failed;
+  lines += res.lines, numbers += res.numbers;
+}
+
+// diff the outputs against one reference on the worker processes of the tree mode,
+// the rules are taken from the reference stem (fileB.cfg), if any
+static void
+against_diff(const char *rhs_s, const char *lhs_s[], int n)
+{
+  struct tree_res res = { 0 };
+  char cfg_s[FILENAME_MAX];
+  int jobs = option.jobs;
+
+  ensure(!option.serie && !option.list && !option.watch,
+         "against mode is exclusive with serie, list and watch modes");
+  ensure(!option.rhs_res, "against mode excludes results of the shared reference (--rhsres)");
+
+  // shared output files are written by one process
+  if (jobs != 1 && (option.report || option.rprof)) {
+    warning("--report and --rule-profile serialize against mode (--jobs 1)");
+    jobs = 1;
+  }
+
+  against_load(rhs_s);
+
+  // reference stem, without compression and reference extensions
+  snprintf(cfg_s, sizeof cfg_s, "%s", against.file);
+  char *dot = strrchr(cfg_s, '.');
+  if (dot && is_zipext(dot)) *dot = 0, dot = strrchr(cfg_s, '.');
+  if (dot && !strcmp(dot, option.ref_e)) *dot = 0;
+
+  struct tree *tree = tree_list(lhs_s, n, rhs_s, cfg_s);
+  if (shard) tree_shard(tree, shard);
+  tree_run(tree, jobs, tree_pair, &res);
+  tree_free(tree);
+
+  free(against.buf);
+  against.buf = 0, against.len = 0;
+
+  total += res.total, failed  += res.failed;
+  lines += res.lines, numbers += res.numbers;
+}
+
 int
 main(int argc_, char** argv_)
 {
@@ -117,7 +615,7 @@ main(int argc_, char** argv_)
   // argument list loop (too long, should refactored)
   while (option.argi < argc) {
     const char *lhs_s = 0, *rhs_s = 0, *cfg_s = 0;
-    int n = 0;
+    int n = 0, lhs_i = 0;
 
     // check for test or test suite transition (chaining)
     check_transition(argv, &total, &failed, lines, numbers);
@@ -126,6 +624,12 @@ main(int argc_, char** argv_)
     parse_args(argc, argv);
 
     // setup filenames [incremental]
+    if (option.against) {
+      for (lhs_i = option.argi; option.argi < argc; option.argi++)
+        if (is_option(argv[option.argi])) break;
+      if (lhs_i < option.argi) lhs_s = argv[lhs_i];
+      rhs_s = option.against;
+    } else
     if (!option.list) {
       int i;
       for (i = option.argi; i < option.argi+3; i++)
@@ -149,85 +653,34 @@ main(int argc_, char** argv_)
       option.suite = 0;
     }
 
+    // shard mode, skip the pairs assigned to other shards
+    if (option.shard_n && !shard)
+      shard = shard_alloc(option.shard_i, option.shard_n, option.shard_h);
+
+    if (shard && !option.tree && !option.against &&
+        !shard_take(shard, option.list ? 0 : option.test, file_size(lhs_s, option.out_e))) {
+      debug("pair '%s'|'%s' skipped (other shard)", lhs_s, rhs_s);
+      clear_args();
+      continue;
+    }
+
+    // tree mode, pair and diff the files of the directory trees
+    if (option.tree) {
+      tree_diff(lhs_s, rhs_s, cfg_s);
+      clear_args();
+      continue;
+    }
+
+    // against mode, diff the outputs against one reference
+    if (option.against) {
+      against_diff(rhs_s, argv+lhs_i, option.argi-lhs_i);
+      clear_args();
+      continue;
+    }
+
     // serie loop
     while (option.serie || !n) {
-      FILE *lhs_fp=0, *rhs_fp=0, *cfg_fp=0, *lhs_rfp=0, *rhs_rfp=0;
-      int nn = n;
-
-      // clean filenames
-      *option.lhs_file = *option.rhs_file = *option.cfg_file = 0;
-       option.lhs_zip  =  option.rhs_zip  =  option.cfg_zip  = 0;
-
-      // open files
-      lhs_fp = open_file(lhs_s, option.lhs_res ? &lhs_rfp : 0, &nn, option.out_e, 1, 0);
-      if (!lhs_fp && n) break; // end of serie
-      rhs_fp = open_file(rhs_s, option.rhs_res ? &rhs_rfp : 0, &nn, option.ref_e, !option.list, 1);
-      cfg_fp = open_file(cfg_s,                             0, &nn, option.cfg_e, !option.list, 0);
-      if (n != nn) { n = nn; --total; }
-
-      if (!lhs_fp) {
-        if (option.list) {
-          warning("output file '%s[.out]' not found, skipping diff", lhs_s);
-          close_file(rhs_fp, option.rhs_zip);
-          close_file(cfg_fp, option.cfg_zip);
-          close_file(rhs_rfp, 0);
-          ++failed;
-          break;
-        } else
-          invalid_file(lhs_s);
-      }
-
-      if (!rhs_fp) {
-        if (option.list) {
-          warning("reference file '%s.ref' not found, skipping diff", rhs_s);
-          close_file(lhs_fp, option.lhs_zip);
-          close_file(cfg_fp, option.cfg_zip);
-          close_file(lhs_rfp, 0);
-          ++failed;
-          break;
-        } else
-          invalid_file(rhs_s);
-      }
-
-      inform("processing '%s'|'%s'", option.lhs_file, option.rhs_file);
-
-      // create context of constraints (using default size)
-      struct context *cxt = context_alloc(0);
-
-      // load constraints
-      if (cfg_fp) cxt = context_scan(cxt, cfg_fp);
-
-      // show constraints
-      if (option.debug) {
-        debug("rules list:");
-        context_print(cxt, stderr);
-      }
-
-      // ndiff loop
-      struct ndiff *dif = ndiff_alloc(lhs_fp, rhs_fp, cxt, 0, option.nregs);
-      ndiff_option(dif, &option.keep, &option.blank, &option.check, &option.recycle);
-      ndiff_result(dif, lhs_rfp, rhs_rfp);
-      ndiff_loop(dif);
-
-      // print summary
-      if (diff_summary(dif) > 0) ++failed;
-
-      // collect stats
-      { int row; long num;
-        ndiff_getInfo(dif, &row, 0, 0, &num);
-        lines += row-1; numbers += num;
-      }
-
-      // destroy components
-      ndiff_free(dif);
-      context_free(cxt);
-
-      // close files
-      close_file(lhs_fp, option.lhs_zip);
-      close_file(rhs_fp, option.rhs_zip);
-      close_file(cfg_fp, option.cfg_zip);
-      close_file(lhs_rfp, 0);
-      close_file(rhs_rfp, 0);
+      if (!diff_pair(lhs_s, rhs_s, cfg_s, &n)) break;
 
       // clear options
       clear_args();
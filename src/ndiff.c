@@ -15,12 +15,18 @@
  o---------------------------------------------------------------------o
 */
 
+#define _POSIX_C_SOURCE 200112L
+
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
 #include <ctype.h>
 #include <math.h>
 
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
 #include "args.h"
 #include "error.h"
 #include "utils.h"
@@ -28,17 +34,40 @@
 #include "context.h"
 #include "register.h"
 #include "constraint.h"
+#include "stats.h"
+#include "flight.h"
+#include "report.h"
+#include "errstats.h"
+#include "writer.h"
+#include "incr.h"
+
+#ifdef _WIN32
+#define ftello(fp)          _ftelli64(fp)
+#define fseeko(fp, o, w)    _fseeki64(fp, o, w)
+#endif
 
 #define T struct ndiff
 #define C struct constraint
 
+// ----- constants
+
+// chars kept before and available after the scan position in a sliding window
+enum { win_margin = 512, win_min = 4*win_margin };
+
+// lines searched by gotoLine on the left side before searching the right side on a thread (default)
+enum { goto_async = 4096 };
+
+// rows per block of the incremental mode (default)
+enum { incr_rows = 16384 };
+
 // ----- types
 
 struct ndiff {
   // files
   FILE *lhs_f, *rhs_f;
   FILE *lhs_r, *rhs_r; // result files
-  int   row_i,  col_i; // line, num-column
+  struct writer *lhs_w, *rhs_w; // result writers
+  llong row_i,  col_i; // line, num-column
 
   // context
   struct context* cxt;
@@ -49,19 +78,101 @@ struct ndiff {
 
   // options
   int blank, check, recycle;
+  bool slow; // generic loop variant
+  llong gto_max; // goto search limit (lines), 0: unbounded
+  llong gto_asy; // goto lines before the concurrent search, 0: never
+  bool  stop;    // diff abandoned (goto failed on unseekable input)
+  bool  held;    // input streams locked by the loop
+
+  // region of rows and number columns (0 first: all)
+  llong row_f, row_l;
+  llong col_f, col_l;
 
   // diff counter
-  int   cnt_i, max_i;
+  llong cnt_i, max_i;
 
   // numbers counter
-  long  num_i;
+  llong num_i;
 
   // buffers
   int   lhs_i,  rhs_i; // char-columns
   int   buf_n;         // capacity
   char *lhs_b, *rhs_b;
+
+  // sliding window over long lines
+  int   win;                // max capacity (0: unbounded)
+  llong lhs_o,  rhs_o;      // char-columns of buffers start
+  int   lhs_n,  rhs_n;      // chars in buffers
+  bool  lhs_more, rhs_more; // line continues in files
+
+  // sampled rows (0 threshold: all rows)
+  ullong smp_thr, smp_key;   // row hash threshold and seed key
+  ullong smp_rf,  smp_rl;    // rows of rules using registers (run fully)
+  llong  smp_rows, smp_skip; // rows eligible to sampling, skipped
+
+  // statistics
+  struct stats *sta;
+  struct context_prof *prof;
+
+  // flight recorder
+  struct flight *fr;
+
+  // diff report (replace warnings)
+  struct report *rep;
+
+  // error statistics
+  struct errstats *es;
+
+  // canonical filter, number rewrites of the current row
+  bool  canon;
+  llong cn_row;
+  int   cn_n, cn_max;
+  struct ndiff_cn *cn;
+
+  // incremental mode, block being diffed since the last boundary
+  struct incr *inc;
+  struct incr_blk inc_b;
+  llong inc_rows, inc_row;          // rows per block, next boundary
+  llong inc_lo, inc_ro;             // offsets of the block
+  llong inc_cnt, inc_num;           // counters at the block start
+  bool  inc_open;
+};
+
+struct ndiff_cn {
+  int  side, pos, len, n;
+  char str[32];
 };
 
+// ----- private (stats helpers)
+
+#define STATS_LAP(dif, stage) \
+  ((void)((dif)->sta && (dif)->sta->on && (stats_lap((dif)->sta, stage),0)))
+
+#define STATS_ADD(dif, field, val) \
+  ((void)((dif)->sta && ((dif)->sta->field += (val),0)))
+
+// ----- private (flight recorder helpers)
+
+#define FLIGHT(dif, ...) \
+  ((void)((dif)->fr && (flight_put((dif)->fr, __VA_ARGS__),0)))
+
+// ----- private (error statistics helpers)
+
+#define ERRSTATS(dif, ...) \
+  ((void)((dif)->es && (errstats_add((dif)->es, __VA_ARGS__),0)))
+
+// ----- private (template helpers)
+
+// loop variants: fast (no xcheck, blank, recycle nor trace) and slow (generic)
+#ifdef __GNUC__
+#define NDIFF_TPL static inline __attribute__((always_inline))
+#else
+#define NDIFF_TPL static inline
+#endif
+
+// trace in slow variants only, compiled out of fast variants
+#define TRACE(...) ((void)(slow && (trace(__VA_ARGS__),0)))
+
 // ----- private (parser helpers)
 
 static int
@@ -168,6 +279,14 @@ parse_number (char *buf, int *d_, int *n_, int *e_, int *f_)
   return i;
 }
 
+static inline int
+strlen25 (const char *str)
+{
+  int n = 0;
+  while (n < 25 && str[n]) n++;
+  return n;
+}
+
 static void
 skip_identifier(char *restrict *lhs, char *restrict *rhs, int strict)
 {
@@ -193,15 +312,109 @@ is_valid_omit(const char *lhs_p, const char *rhs_p, const T *dif, const char *ta
   return true;
 }
 
+// ----- private (sliding window helpers)
+
+// discard the rest of a long line partially loaded
+static inline void
+ndiff_endLine (T *dif)
+{
+  int s1 = 0, s2 = 0, c1, c2;
+
+  if (dif->lhs_more) {
+    c1 = skipLine(dif->lhs_f, &s1);
+    STATS_ADD(dif, lhs_bytes, s1 + (c1 == '\n'));
+  }
+
+  if (dif->rhs_more) {
+    c2 = skipLine(dif->rhs_f, &s2);
+    STATS_ADD(dif, rhs_bytes, s2 + (c2 == '\n'));
+  }
+
+  dif->lhs_more = dif->rhs_more = false;
+  dif->lhs_o = dif->rhs_o = 0;
+}
+
+// drop chars before *p but the margin and read the next chunk of the line
+static inline int
+ndiff_slideBuf (FILE *fp, char *buf, int n, char *restrict *p, int *len_, llong *off_, bool *more_)
+{
+  int k = *p - buf - win_margin, len = *len_;
+
+  if (k > 0) {
+    memmove(buf, buf+k, len-k+1);
+    *p -= k, *off_ += k, len -= k;
+  }
+
+  int s = len;
+  int c = readData(fp, buf+s, n-s, &s);
+
+  *more_ = c != '\n' && c != EOF;
+  *len_  = s;
+
+  return s - len + (c == '\n');
+}
+
+static void
+ndiff_slide (T *dif, char *restrict *lhs_p, char *restrict *rhs_p)
+{
+  if (dif->lhs_more) {
+    int s1 = ndiff_slideBuf(dif->lhs_f, dif->lhs_b, dif->buf_n, lhs_p, &dif->lhs_n, &dif->lhs_o, &dif->lhs_more);
+    STATS_ADD(dif, lhs_bytes, s1);
+  }
+
+  if (dif->rhs_more) {
+    int s2 = ndiff_slideBuf(dif->rhs_f, dif->rhs_b, dif->buf_n, rhs_p, &dif->rhs_n, &dif->rhs_o, &dif->rhs_more);
+    STATS_ADD(dif, rhs_bytes, s2);
+  }
+
+  trace("  window slided to char-columns %lld|%lld", dif->lhs_o, dif->rhs_o);
+}
+
+// scan position close to the end of a partially loaded line
+static inline bool
+ndiff_winEnd (const T *dif, const char *lhs_p, const char *rhs_p)
+{
+  return (dif->lhs_more && lhs_p >= dif->lhs_b + dif->lhs_n - win_margin) ||
+         (dif->rhs_more && rhs_p >= dif->rhs_b + dif->rhs_n - win_margin);
+}
+
 // ----- private (ctor & dtor helpers)
 
 static inline void
 ndiff_reset_buf (T *dif)
 {
+  ndiff_endLine(dif);
   dif->lhs_i = dif->rhs_i = 0;
   dif->lhs_b[0] = dif->rhs_b[0] = 0;
 }
 
+// reset the state, keep files, buffers, registers (cleared) and options
+static inline void
+ndiff_init (T *dif)
+{
+  dif->lhs_b[0] = 0;
+  dif->rhs_b[0] = 0;
+  memset(dif->reg, 0, dif->reg_n * sizeof *dif->reg);
+
+  *dif = (T) {
+    .lhs_f = dif->lhs_f, .rhs_f = dif->rhs_f,
+    .lhs_r = dif->lhs_r, .rhs_r = dif->rhs_r,
+    .lhs_w = dif->lhs_w, .rhs_w = dif->rhs_w,
+    .lhs_b = dif->lhs_b, .rhs_b = dif->rhs_b,
+    .blank = dif->blank, .check = dif->check, .recycle = dif->recycle,
+    .max_i = dif->max_i, .win = dif->win, .gto_max = dif->gto_max, .gto_asy = dif->gto_asy,
+    .row_f = dif->row_f, .row_l = dif->row_l, .col_f = dif->col_f, .col_l = dif->col_l,
+    .smp_thr = dif->smp_thr, .smp_key = dif->smp_key,
+    .smp_rf  = dif->smp_rf , .smp_rl  = dif->smp_rl ,
+    .reg = dif->reg, .reg_n = dif->reg_n,
+    .cxt = dif->cxt,      
+    .sta = dif->sta, .fr = dif->fr, .rep = dif->rep, .es = dif->es,
+    .canon = dif->canon, .cn = dif->cn, .cn_max = dif->cn_max, .cn_row = -1,
+    .inc = dif->inc, .inc_rows = dif->inc_rows, .inc_b.reg = dif->inc_b.reg,
+    .buf_n = dif->buf_n
+  };
+}
+
 static inline void
 ndiff_setup (T *dif, int n, int r)
 {
@@ -216,19 +429,11 @@ ndiff_setup (T *dif, int n, int r)
   dif->reg   = malloc(r * sizeof *dif->reg  );
   ensure(dif->lhs_b && dif->rhs_b && dif->reg, "out of memory");
 
-  dif->lhs_b[0] = 0;
-  dif->rhs_b[0] = 0;
-  memset(dif->reg, 0, r * sizeof *dif->reg);
+  dif->buf_n = n;
+  dif->reg_n = r;
+  ndiff_init(dif);
 
-  *dif = (T) {
-    .lhs_f = dif->lhs_f, .rhs_f = dif->rhs_f,
-    .lhs_b = dif->lhs_b, .rhs_b = dif->rhs_b,
-    .blank = dif->blank, .check = dif->check,
-    .max_i = dif->max_i,
-    .reg = dif->reg, .reg_n = r,
-    .cxt = dif->cxt,      
-    .buf_n = n
-  };
+  if (dif->sta && dif->sta->buf_max < n) dif->sta->buf_max = n;
 }
 
 static inline void
@@ -237,11 +442,20 @@ ndiff_teardown (T *dif)
   free(dif->lhs_b);
   free(dif->rhs_b);
   free(dif->reg  );
+  free(dif->cn   );
+  free(dif->inc_b.reg);
+  writer_free(dif->lhs_w);
+  writer_free(dif->rhs_w);
 
   *dif = (T) {
     .lhs_f = dif->lhs_f, .rhs_f = dif->rhs_f,
-    .blank = dif->blank, .check = dif->check,
-    .cxt = dif->cxt
+    .blank = dif->blank, .check = dif->check, .win = dif->win, .canon = dif->canon,
+    .gto_max = dif->gto_max, .gto_asy = dif->gto_asy,
+    .row_f = dif->row_f, .row_l = dif->row_l, .col_f = dif->col_f, .col_l = dif->col_l,
+    .smp_thr = dif->smp_thr, .smp_key = dif->smp_key,
+    .smp_rf  = dif->smp_rf , .smp_rl  = dif->smp_rl ,
+    .cxt = dif->cxt, .sta = dif->sta, .fr = dif->fr, .rep = dif->rep, .es = dif->es,
+    .inc = dif->inc, .inc_rows = dif->inc_rows
   };
 }
 
@@ -253,17 +467,52 @@ ndiff_grow (T *dif, int n)
     dif->rhs_b = realloc(dif->rhs_b, n * sizeof *dif->rhs_b);
     ensure(dif->lhs_b && dif->rhs_b, "out of memory");
     dif->buf_n = n;
+    if (dif->sta && dif->sta->buf_max < n) dif->sta->buf_max = n;
   }
 }
 
+// select the loop variant, the fast one requires no xcheck, blank, recycle, canon nor trace
+static inline void
+ndiff_select (T *dif)
+{
+  const C *c;
+
+  dif->slow = dif->check || dif->blank || dif->recycle || dif->canon || !dif->cxt ||
+              logmsg_config.level <= trace_level;
+
+  for (int i = 0; !dif->slow && (c = context_getIdx(dif->cxt, i)); i++)
+    if (c->eps.cmd & eps_trace) dif->slow = true;
+
+  trace("loop variant %s selected", dif->slow ? "slow" : "fast");
+}
+
+// ----- private (sampling helpers)
+
+// splitmix64 finalizer, deterministic row hash
+static inline ullong
+ndiff_hash (ullong x)
+{
+  x += 0x9e3779b97f4a7c15ULL;
+  x  = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x  = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+static inline bool
+ndiff_sampled (const T *dif, llong row)
+{
+  return ((ullong)row >= dif->smp_rf && (ullong)row <= dif->smp_rl) ||
+         ndiff_hash((ullong)row ^ dif->smp_key) < dif->smp_thr;
+}
+
 // ----- private (error & trace helpers)
 
 static void
 ndiff_error(const struct context *cxt,
             const C *c, const C *c2,
-            int row, int col)
+            llong row, llong col)
 {
-  warning("dual constraints differ at %d:%d", row, col);
+  warning("dual constraints differ at %lld:%lld", row, col);
   warning("getIncr select [#%d]", context_findIdx(cxt, c ));
   warning("getAt   select [#%d]", context_findIdx(cxt, c2));
   warning("rules list:");
@@ -272,8 +521,11 @@ ndiff_error(const struct context *cxt,
 }
 
 static void
-ndiff_header(void)
+ndiff_header(const T *dif)
 {
+  if (dif->rep)
+    report_files(dif->rep, option.lhs_file, option.rhs_file, option.test);
+
   if (option.test)
     warning("(*) files '%s'|'%s' from '%s' differ",
             option.lhs_file, option.rhs_file, option.test);
@@ -282,6 +534,15 @@ ndiff_header(void)
             option.lhs_file, option.rhs_file);
 }
 
+static inline void
+ndiff_regEval(const T *dif, const C *c, int i)
+{
+  if (c->eps.form[i])
+    reg_evalRange(dif->reg, dif->reg_n, c->eps.dst[i], c->eps.dst2[i], c->eps.src[i], c->eps.src2[i], c->eps.op[i], c->eps.form[i]);
+  else
+    reg_eval(dif->reg, dif->reg_n, c->eps.dst[i], c->eps.src[i], c->eps.src2[i], c->eps.op[i]);
+}
+
 static void
 ndiff_traceR(const T *dif, const C *c, bool eval,
              double lhs_d, double rhs_d, double scl_d, double off_d,
@@ -298,13 +559,13 @@ ndiff_traceR(const T *dif, const C *c, bool eval,
 
   for (int i=0; i < c->eps.op_n; i++) {
     if (eval)
-      reg_eval(dif->reg, dif->reg_n, c->eps.dst[i], c->eps.src[i], c->eps.src2[i], c->eps.op[i]);
+      ndiff_regEval(dif, c, i);
 
     if (c->eps.dst[i]) {
       pos += sprintf(buf+pos, "R%d=%.2g, ", c->eps.dst[i], reg_getval(dif->reg, dif->reg_n, c->eps.dst[i]));
-      if (c->eps.op[i]=='~') {
+      if (c->eps.dst2[i] || (c->eps.op[i]=='~' && !c->eps.form[i])) {
         pos -= 2;
-        int rn = c->eps.dst[i]+c->eps.src2[i]-c->eps.src[i];
+        int rn = c->eps.dst2[i] ? c->eps.dst2[i] : c->eps.dst[i]+c->eps.src2[i]-c->eps.src[i];
         pos += sprintf(buf+pos, " .. R%d=%.2g, ", rn, reg_getval(dif->reg, dif->reg_n, rn));
       }
     }
@@ -312,6 +573,227 @@ ndiff_traceR(const T *dif, const C *c, bool eval,
   if (pos>2) { buf[pos-2] = 0; trace(buf); }
 }
 
+// ----- private (canonical filter helpers)
+
+// exponent suffix in %e style (at least 2 digits)
+static inline int
+canon_exp (char *buf, int e)
+{
+  int n = 0;
+  buf[n++] = 'e';
+  buf[n++] = e < 0 ? '-' : '+';
+  if (e < 0) e = -e;
+  if (e >= 100) buf[n++] = '0' + e/100;
+  buf[n++] = '0' + e/10%10;
+  buf[n++] = '0' + e%10;
+  return n;
+}
+
+// integer digits
+static inline int
+canon_int (char *buf, llong i)
+{
+  char dig[24];
+  int n = 0, m = 0;
+  ullong u = i < 0 ? -(ullong)i : (ullong)i;
+
+  do dig[m++] = '0' + u%10, u /= 10; while (u);
+  if (i < 0) buf[n++] = '-';
+  while (m) buf[n++] = dig[--m];
+  return n;
+}
+
+// sig (<= 15) significant digits in %e style without trailing zeros, scaled through
+// the powers of 10 table
+static int
+canon_fmt (char *buf, int siz, double v, int sig)
+{
+  double a = fabs(v);
+  int e = (int)floor(log10(a));
+
+  if (e < -80 || e > 80) return snprintf(buf, siz, "%.*e", sig-1, v);
+
+  ullong lo = (ullong)pow10(sig-1), hi = lo*10;
+  ullong u  = (ullong)llround(a * pow10(sig-1-e));
+
+  // fix the floor of log10 near powers of 10 and the rounding overflow
+  if (u <  lo) u = (ullong)llround(a * pow10(sig-e)), --e;
+  if (u >= hi) u /= 10, ++e;
+
+  char dig[16];
+  for (int i = sig-1; i >= 0; i--) dig[i] = '0' + u%10, u /= 10;
+  while (sig > 1 && dig[sig-1] == '0') --sig;
+
+  int n = 0;
+  if (v < 0) buf[n++] = '-';
+  buf[n++] = dig[0];
+  if (sig > 1) {
+    buf[n++] = '.';
+    memcpy(buf+n, dig+1, sig-1), n += sig-1;
+  }
+  return n + canon_exp(buf+n, e);
+}
+
+// number as written rounded to sig (<= 17) significant digits, in %e style without
+// trailing zeros or as integer, return 0 if the number has too many digits
+static int
+canon_text (char *buf, const char *p, int l, int f, int sig)
+{
+  int i = 0, n = 0, nd = 0, k = 0, z = 0, dot = 0;
+  char dig[24];
+
+  if (p[i] == '-' || p[i] == '+') i++;
+
+  for (; i < l && p[i] != 'e'; i++) {
+    if (p[i] == '.') { dot = 1; continue; }
+    if (!nd && p[i] == '0') { z += dot; continue; }
+    if (nd == sizeof dig) return 0;
+    dig[nd++] = p[i], k += !dot;
+  }
+
+  if (!nd) { buf[0] = '0'; return 1; }
+  if (p[0] == '-') buf[n++] = '-';
+
+  if (!f) {
+    memcpy(buf+n, dig, nd);
+    return n + nd;
+  }
+
+  int e = (k ? k-1 : -z-1) + (i < l ? atoi(p+i+1) : 0);
+
+  // decimal rounding, half up
+  if (nd > sig) {
+    int up = dig[sig] >= '5', j = sig;
+    nd = sig;
+    while (up && j-- > 0)
+      if (dig[j] == '9') dig[j] = '0'; else dig[j]++, up = 0;
+    if (up) dig[0] = '1', nd = 1, ++e;
+  }
+
+  while (nd > 1 && dig[nd-1] == '0') --nd;
+
+  buf[n++] = dig[0];
+  if (nd > 1) {
+    buf[n++] = '.';
+    memcpy(buf+n, dig+1, nd-1), n += nd-1;
+  }
+  return n + canon_exp(buf+n, e);
+}
+
+// shortest %e representation reading back to the same double (15 to 17 digits)
+static int
+canon_shortest (char *buf, int siz, double v)
+{
+  int n = 0;
+
+  for (int p = 14; p <= 16; p++) {
+    n = snprintf(buf, siz, "%.*e", p, v);
+    if (p == 16 || strtod(buf, 0) == v) break;
+  }
+
+  // remove trailing zeros of the mantissa
+  char *e = strchr(buf, 'e'), *z = e;
+  while (z[-1] == '0') --z;
+  if (z[-1] == '.') --z;
+  memmove(z, e, buf+n-e+1);
+
+  return n - (int)(e-z);
+}
+
+// significant digits required by a tolerance (17: exact)
+static inline int
+canon_digits (double tol)
+{
+  return tol > 0 ? imax(1, imin(17, (int)floor(-log10(tol)))) : 17;
+}
+
+static void
+ndiff_canonPut (T *dif, int side, int pos, int len, const char *str, int n)
+{
+  if (dif->cn_row != dif->row_i) dif->cn_n = 0, dif->cn_row = dif->row_i;
+
+  if (dif->cn_n == dif->cn_max) {
+    dif->cn_max = dif->cn_max ? 2*dif->cn_max : 64;
+    dif->cn = realloc(dif->cn, dif->cn_max * sizeof *dif->cn);
+    ensure(dif->cn, "out of memory");
+  }
+
+  struct ndiff_cn *cn = &dif->cn[dif->cn_n++];
+  cn->side = side, cn->pos = pos, cn->len = len, cn->n = n;
+  memcpy(cn->str, str, n);
+}
+
+// rewrite a passing number according to its rule: masked (ign, omit), kept (equ),
+// rounded to abs and to the digits of rel and dig (any: loosest, all: tightest), or exact
+static void
+ndiff_canonNum (T *dif, const C *c, int side, const char *p, int l, int n, int f,
+                double abs, double rel, double dig)
+{
+  enum eps_cmd cmd = c->eps.cmd;
+  char buf[sizeof dif->cn->str];
+  int len = 0, sig = 17;
+
+  if (!l || cmd & eps_equ) return;
+
+  if (cmd & (eps_ign | eps_omit)) {
+    buf[0] = '*', len = 1;
+    goto put;
+  }
+
+  // digits kept by rel and dig (floating numbers only)
+  if (f && cmd & (eps_rel | eps_dig)) {
+    int s1 = cmd & eps_rel ? canon_digits(rel) : 0;
+    int s2 = cmd & eps_dig ? canon_digits(dig*pow10(-n)) : 0;
+    sig = !s1 ? s2 : !s2 ? s1 : cmd & eps_any ? imin(s1, s2) : imax(s1, s2);
+  }
+
+  // quantum of abs, ignored below the precision of the number
+  double v = 0, q = cmd & eps_abs ? abs : 0;
+  if (q > 0) {
+    v = strtod(p, 0);
+    if (!isfinite(v) || !(fabs(v/q) < 0x1p52)) q = 0;
+  }
+
+  if (q > 0) {
+    v = nearbyint(v/q)*q;
+    if (v == 0) { buf[0] = '0', len = 1; goto put; }
+    if (!f && fabs(v) < 1e15) { len = canon_int(buf, (llong)v); goto put; }
+
+    int s = imax(1, (int)floor(log10(fabs(v))) - (int)floor(log10(q)) + 1);
+    sig = sig == 17 ? s : cmd & eps_any ? imin(sig, s) : imax(sig, s);
+    len = sig <= 15 ? canon_fmt(buf, sizeof buf, v, sig) : canon_shortest(buf, sizeof buf, v);
+    goto put;
+  }
+
+  // as written, rounded to sig digits or exact when it reads back (up to 15 digits)
+  if (!f || sig <= 15 || n <= 15) len = canon_text(buf, p, l, f, sig);
+  if (!len) {
+    v = strtod(p, 0);
+    if (!isfinite(v)) return;
+    len = !v         ? (buf[0] = '0', 1) :
+          sig <= 15 ? canon_fmt(buf, sizeof buf, v, sig) : canon_shortest(buf, sizeof buf, v);
+  }
+
+put:
+  ndiff_canonPut(dif, side, (int)(p - (side ? dif->rhs_b : dif->lhs_b)), l, buf, len);
+}
+
+static void
+ndiff_canonLine (T *dif, struct writer *w, const char *buf, int side)
+{
+  int beg = 0;
+
+  for (int i=0; i < dif->cn_n; i++) {
+    const struct ndiff_cn *cn = &dif->cn[i];
+    if (cn->side != side) continue;
+    writer_put(w, buf+beg, cn->pos-beg);
+    writer_put(w, cn->str, cn->n);
+    beg = cn->pos + cn->len;
+  }
+
+  writer_line(w, buf+beg);
+}
+
 // -----------------------------------------------------------------------------
 // ----- interface
 // -----------------------------------------------------------------------------
@@ -324,9 +806,10 @@ ndiff_alloc (FILE *lhs_f, FILE *rhs_f, struct context *cxt, int n_, int r_)
   T *dif = malloc(sizeof *dif);
   ensure(dif, "out of memory");
 
-  *dif = (T) { .lhs_f = lhs_f, .rhs_f = rhs_f, .cxt = cxt };
+  *dif = (T) { .lhs_f = lhs_f, .rhs_f = rhs_f, .cxt = cxt, .gto_asy = goto_async };
 
   ndiff_setup(dif, n_, r_);
+  ndiff_select(dif);
   return dif;
 }
 
@@ -345,6 +828,17 @@ ndiff_clear (T *dif)
   int rn = dif->reg_n;
   ndiff_teardown(dif);
   ndiff_setup(dif, 0, rn);
+  ndiff_select(dif);
+}
+
+void
+ndiff_reset (T *dif, FILE *lhs_f, FILE *rhs_f)
+{
+  assert(dif && lhs_f && rhs_f);
+  dif->lhs_f = lhs_f;
+  dif->rhs_f = rhs_f;
+  ndiff_init(dif);
+  ndiff_select(dif);
 }
 
 int
@@ -359,12 +853,73 @@ ndiff_skipLine (T *dif)
   c1 = skipLine(dif->lhs_f, &s1);
   c2 = skipLine(dif->rhs_f, &s2);
 
+  STATS_ADD(dif, lhs_bytes, s1 + (c1 == '\n'));
+  STATS_ADD(dif, rhs_bytes, s2 + (c2 == '\n'));
+
   dif->col_i  = 0;
   dif->row_i += 1;
 
+  FLIGHT(dif, flight_skip, dif->row_i, 0, 0, 0, 0, 0, 0, 0, 0);
+
+  return c1 == EOF || c2 == EOF ? EOF : !EOF;
+}
+
+int
+ndiff_skipLines (T *dif, llong n)
+{
+  assert(dif);
+  int s1 = 0, s2 = 0;
+  int c1 = 0, c2 = 0;
+  llong b1 = 0, b2 = 0, i = 0;
+
+  ndiff_reset_buf(dif);
+
+  // tight loop without rules lookup, stop at end of file like skipLine
+  while (i < n) {
+    c1 = skipLineFast(dif->lhs_f, &s1);
+    c2 = skipLineFast(dif->rhs_f, &s2);
+    b1 += s1 + (c1 == '\n');
+    b2 += s2 + (c2 == '\n');
+    i  += 1;
+    if (c1 == EOF || c2 == EOF) break;
+  }
+
+  STATS_ADD(dif, lhs_bytes, b1);
+  STATS_ADD(dif, rhs_bytes, b2);
+
+  dif->col_i  = 0;
+  dif->row_i += i;
+
+  FLIGHT(dif, flight_skip, dif->row_i, 0, 0, 0, 0, 0, 0, 0, 0);
+
   return c1 == EOF || c2 == EOF ? EOF : !EOF;
 }
 
+// move both inputs before the first row of the region, count lines without tokenizing
+static void
+ndiff_position (T *dif)
+{
+  llong n = dif->row_f-1 - dif->row_i, s1 = 0, s2 = 0;
+
+  ndiff_reset_buf(dif);
+
+  llong n1 = skipLinesBulk(dif->lhs_f, n, &s1);
+  llong n2 = skipLinesBulk(dif->rhs_f, n, &s2);
+
+  STATS_ADD(dif, lhs_bytes, s1);
+  STATS_ADD(dif, rhs_bytes, s2);
+
+  dif->col_i  = 0;
+  dif->row_i += n1 < n2 ? n1 : n2;
+
+  FLIGHT(dif, flight_skip, dif->row_i, 0, 0, 0, 0, 0, 0, 0, 0);
+
+  if (n1 < n || n2 < n)
+    warning("input files end before row %lld, region is empty", dif->row_f);
+  else
+    debug("inputs positioned at row %lld (%lld|%lld bytes skipped)", dif->row_f, s1, s2);
+}
+
 int
 ndiff_fillLine (T *dif, const char *lhs_b, const char *rhs_b)
 {
@@ -392,22 +947,45 @@ ndiff_readLine (T *dif)
   int s1 = 0, s2 = 0;
   int c1, c2;
 
-  trace("->readLine line %d", dif->row_i);
+  trace("->readLine line %lld", dif->row_i);
 
   ndiff_reset_buf(dif);
 
-  while (1) {
-    c1 = readLine(dif->lhs_f, dif->lhs_b+s1, dif->buf_n-s1, &s1);
-    c2 = readLine(dif->rhs_f, dif->rhs_b+s2, dif->buf_n-s2, &s2);
-    if (c1 == '\n' || c2 == '\n' || c1 == EOF || c2 == EOF) break;
-    ndiff_grow(dif, 2*dif->buf_n);
+  c1 = readLineFast(dif->lhs_f, dif->lhs_b, dif->buf_n, &s1);
+  c2 = readLineFast(dif->rhs_f, dif->rhs_b, dif->buf_n, &s2);
+
+  // complete the lines (enlarge buffers up to the window)
+  while ((c1 != '\n' && c1 != EOF) || (c2 != '\n' && c2 != EOF)) {
+    if (dif->win && dif->buf_n >= dif->win && !dif->lhs_r && !dif->rhs_r) {
+      dif->lhs_more = c1 != '\n' && c1 != EOF;
+      dif->rhs_more = c2 != '\n' && c2 != EOF;
+      trace("  long line, sliding window of %d chars", dif->buf_n);
+      break;
+    }
+
+    ndiff_grow(dif, dif->win && dif->win < 2*dif->buf_n ? imax(dif->win, dif->buf_n+1) : 2*dif->buf_n);
+
+    if (c1 != '\n' && c1 != EOF) c1 = readData(dif->lhs_f, dif->lhs_b+s1, dif->buf_n-s1, &s1);
+    if (c2 != '\n' && c2 != EOF) c2 = readData(dif->rhs_f, dif->rhs_b+s2, dif->buf_n-s2, &s2);
   }
 
+  dif->lhs_n = s1;
+  dif->rhs_n = s2;
+
+  STATS_ADD(dif, lhs_bytes, s1 + (c1 == '\n'));
+  STATS_ADD(dif, rhs_bytes, s2 + (c2 == '\n'));
+
   dif->col_i  = 0;
   dif->row_i += 1;
 
+  FLIGHT(dif, flight_line, dif->row_i, 0, 0, 0, 0, 0, 0, 0, 0);
+
+  // TFS header lines name the columns
+  if (dif->es && (*dif->lhs_b == '*' || *dif->lhs_b == '$'))
+    errstats_tfs(dif->es, dif->row_i, dif->lhs_b);
+
   trace("  buffers: '%.25s'|'%.25s'", dif->lhs_b, dif->rhs_b);
-  trace("<-readLine line %d", dif->row_i);
+  trace("<-readLine line %lld", dif->row_i);
 
   return c1 == EOF || c2 == EOF ? EOF : !EOF;
 }
@@ -415,74 +993,250 @@ ndiff_readLine (T *dif)
 int
 ndiff_outLine(T *dif)
 {
-  int c1=0, c2=0;
+  if (dif->canon && dif->cn_row == dif->row_i && dif->cn_n) {
+    if (dif->lhs_w) ndiff_canonLine(dif, dif->lhs_w, dif->lhs_b, 0);
+    if (dif->rhs_w) ndiff_canonLine(dif, dif->rhs_w, dif->rhs_b, 1);
+  } else {
+    if (dif->lhs_w) writer_line(dif->lhs_w, dif->lhs_b);
+    if (dif->rhs_w) writer_line(dif->rhs_w, dif->rhs_b);
+  }
 
-  if (dif->lhs_r) c1 = fprintf(dif->lhs_r, "%s\n", dif->lhs_b);
-  if (dif->rhs_r) c2 = fprintf(dif->rhs_r, "%s\n", dif->rhs_b);
+  return !EOF; // write errors are raised by the writers
+}
 
-  return c1 == EOF || c2 == EOF ? EOF : !EOF;
+// search limit of goto rule
+static inline llong
+ndiff_gotoMax (const T *dif, const C *c)
+{
+  return c->eps.gto_max ? c->eps.gto_max : dif->gto_max;
 }
 
-int
-ndiff_gotoLine (T *dif, const C *c)
+// tag not found within the search limit, restore both sides and read the line
+static int
+ndiff_gotoFail (T *dif, const C *c, llong p1, llong p2, llong i1, llong i2, bool f1, bool f2)
 {
-  assert(dif && c);
+  const char *tag = c->eps.tag;
+  llong max = ndiff_gotoMax(dif, c);
+  bool  restored = p1 >= 0 && p2 >= 0 && !fseeko(dif->lhs_f, p1, SEEK_SET) && !fseeko(dif->rhs_f, p2, SEEK_SET);
+
+  if (dif->prof) dif->prof[c->idx].fails++;
+  FLIGHT(dif, flight_goto, dif->row_i, 0, i1, i2, c->idx, c->line, 1, 0, 0);
+
+  if (++dif->cnt_i <= dif->max_i) {
+    if (dif->cnt_i == 1) ndiff_header(dif);
+    if (dif->rep) {
+      struct report_rec r = {
+        .cnt = dif->cnt_i, .row = dif->row_i+1,
+        .lhs_p = f1 ? tag : "", .lhs_n = f1 ? strlen(tag) : 0,
+        .rhs_p = f2 ? tag : "", .rhs_n = f2 ? strlen(tag) : 0,
+        .rule = c->idx, .line = c->line
+      };
+      report_str(dif->rep, &r);
+    } else {
+      warning("(%lld) goto tag '%s' not found within %lld lines after line %lld (%s|%s)", dif->cnt_i,
+              tag, max, dif->row_i, f1 ? "found" : "missing", f2 ? "found" : i2 ? "missing" : "-");
+      if (!restored)
+        warning("(%lld) input not seekable, diff stopped", dif->cnt_i);
+    }
+    if (dif->fr) flight_dump(dif->fr, stderr);
+  }
 
-  int c1=0, c2=0, i1=0, i2=0;
+  trace("<-goto%s line %lld not found (%+lld|%+lld)%s", c->eps.cmd & eps_goto ? "Line" : "Num",
+        dif->row_i, i1, i2, restored ? ", restored" : "");
 
-  trace("->gotoLine line %d", dif->row_i);
+  if (restored) return ndiff_readLine(dif);
 
-  // --- lhs ---
-  while (1) {
-    int s1 = 0;
+  // sides are misaligned, nothing sensible can follow
+  dif->lhs_b[0] = dif->rhs_b[0] = 0;
+  dif->lhs_i = dif->rhs_i = 0;
+  dif->col_i = 0;
+  dif->stop  = true;
 
-    dif->lhs_i    = 0;
-    dif->lhs_b[0] = 0;
+  return EOF;
+}
 
-    if (c1 == EOF) break;
+// search of the tag in the right file on a thread, while the left file is searched
 
-    while (1) {
-      c1 = readLine(dif->lhs_f, dif->lhs_b+s1, dif->buf_n-s1, &s1);
-      if (c1 == '\n' || c1 == EOF) break;
-      ndiff_grow(dif, 2*dif->buf_n);
-    }
+struct ndiff_side {
+  FILE  *fp;
+  const char *tag;
+  llong  max, n, bytes; // search limit, lines and bytes read
+  char  *buf;           // last line read
+  int    buf_n, c;
+  bool   found, oom;      // errors are reported by the main thread
+};
 
-    i1 += 1;
-    trace("  lhs[%d]: '%s'", dif->row_i+i1, dif->lhs_b);
+#ifndef _WIN32
 
-    // search for tag
-    if (strstr(dif->lhs_b, c->eps.tag)) break;
-  }
+static void*
+ndiff_gotoSide (void *s_)
+{
+  struct ndiff_side *s = s_;
+
+  flockfile(s->fp);
 
-  // --- rhs ---
   while (1) {
-    int s2 = 0;
+    int k = 0;
 
-    dif->rhs_i    = 0;
-    dif->rhs_b[0] = 0;
+    s->buf[0] = 0;
 
-    if (c2 == EOF) break;
+    if (s->c == EOF) break;
 
     while (1) {
-      c2 = readLine(dif->rhs_f, dif->rhs_b+s2, dif->buf_n-s2, &s2);
-      if (c2 == '\n' || c2 == EOF) break;
-      ndiff_grow(dif, 2*dif->buf_n);
+      s->c = readLineFast(s->fp, s->buf+k, s->buf_n-k, &k);
+      if (s->c == '\n' || s->c == EOF) break;
+      char *buf = realloc(s->buf, 2*s->buf_n);
+      if (!buf) { s->oom = true; goto quit; }
+      s->buf = buf, s->buf_n *= 2;
     }
 
-    i2 += 1;
-    trace("  rhs[%d]: '%s'", dif->row_i+i2, dif->rhs_b);
+    s->n += 1;
+    s->bytes += k + (s->c == '\n');
 
-    // search for tag
-    if (strstr(dif->rhs_b, c->eps.tag)) break;
+    if ((s->found = strstr(s->buf, s->tag) != 0)) break;
+    if (s->n == s->max) break;
   }
 
+quit:
+  funlockfile(s->fp);
+
+  return 0;
+}
+
+static bool
+ndiff_gotoStart (T *dif, const C *c, llong max, struct ndiff_side *s, pthread_t *thr)
+{
+  // keep the trace of the search in order
+  if (logmsg_config.level <= trace_level) return false;
+
+  *s = (struct ndiff_side) { .fp = dif->rhs_f, .tag = c->eps.tag, .max = max, .buf_n = dif->buf_n };
+  s->buf = malloc(s->buf_n);
+  if (!s->buf) return false;
+
+  if (dif->held) funlockfile(dif->rhs_f);
+
+  if (pthread_create(thr, 0, ndiff_gotoSide, s)) {
+    if (dif->held) flockfile(dif->rhs_f);
+    free(s->buf);
+    return false;
+  }
+
+  return true;
+}
+
+static void
+ndiff_gotoJoin (T *dif, struct ndiff_side *s, pthread_t thr)
+{
+  pthread_join(thr, 0);
+
+  if (dif->held) flockfile(dif->rhs_f);
+
+  ensure(!s->oom, "out of memory");
+
+  ndiff_grow(dif, s->buf_n);
+  strcpy(dif->rhs_b, s->buf);
+  dif->rhs_i = 0;
+  STATS_ADD(dif, rhs_bytes, s->bytes);
+
+  free(s->buf);
+}
+
+#endif
+
+int
+ndiff_gotoLine (T *dif, const C *c)
+{
+  assert(dif && c);
+
+  int c1=0, c2=0;
+  llong i1=0, i2=0;
+  llong max = ndiff_gotoMax(dif, c);
+  bool  f1 = false, f2 = false, async = false;
+#ifndef _WIN32
+  struct ndiff_side side;
+  pthread_t thr;
+#endif
+
+  trace("->gotoLine line %lld", dif->row_i);
+
+  ndiff_endLine(dif);
+
+  // positions to restore if the tag is not found within the limit
+  llong p1 = max ? ftello(dif->lhs_f) : -1;
+  llong p2 = max ? ftello(dif->rhs_f) : -1;
+
+  // --- lhs ---
+  while (1) {
+    int s1 = 0;
+
+    dif->lhs_i    = 0;
+    dif->lhs_b[0] = 0;
+
+    if (c1 == EOF) break;
+
+    while (1) {
+      c1 = readLineFast(dif->lhs_f, dif->lhs_b+s1, dif->buf_n-s1, &s1);
+      if (c1 == '\n' || c1 == EOF) break;
+      ndiff_grow(dif, 2*dif->buf_n);
+    }
+
+    i1 += 1;
+    STATS_ADD(dif, lhs_bytes, s1 + (c1 == '\n'));
+    trace("  lhs[%lld]: '%s'", dif->row_i+i1, dif->lhs_b);
+
+    // search for tag
+    if ((f1 = strstr(dif->lhs_b, c->eps.tag) != 0)) break;
+    if (i1 == max) break;
+
+#ifndef _WIN32
+    // long jump, search rhs concurrently
+    if (i1 == dif->gto_asy && !async) async = ndiff_gotoStart(dif, c, max, &side, &thr);
+#endif
+  }
+
+  // --- rhs ---
+#ifndef _WIN32
+  if (async) {
+    ndiff_gotoJoin(dif, &side, thr);
+    c2 = side.c, i2 = side.n, f2 = side.found;
+  }
+#endif
+
+  while (!async) {
+    int s2 = 0;
+
+    dif->rhs_i    = 0;
+    dif->rhs_b[0] = 0;
+
+    if (c2 == EOF || (max && !f1)) break;
+
+    while (1) {
+      c2 = readLineFast(dif->rhs_f, dif->rhs_b+s2, dif->buf_n-s2, &s2);
+      if (c2 == '\n' || c2 == EOF) break;
+      ndiff_grow(dif, 2*dif->buf_n);
+    }
+
+    i2 += 1;
+    STATS_ADD(dif, rhs_bytes, s2 + (c2 == '\n'));
+    trace("  rhs[%lld]: '%s'", dif->row_i+i2, dif->rhs_b);
+
+    // search for tag
+    if ((f2 = strstr(dif->rhs_b, c->eps.tag) != 0)) break;
+    if (i2 == max) break;
+  }
+
+  if (max && !(f1 && f2))
+    return ndiff_gotoFail(dif, c, p1, p2, i1, i2, f1, f2);
+
   dif->col_i  = 0;
-  dif->row_i += imin(i1,i2);
+  dif->row_i += i1 < i2 ? i1 : i2;
 
   // return with last lhs and rhs lines loaded if tag was found
 
+  FLIGHT(dif, flight_goto, dif->row_i, 0, i1, i2, c->idx, c->line, 0, 0, 0);
+
   trace("  buffers: '%.25s'|'%.25s'", dif->lhs_b, dif->rhs_b);
-  trace("<-gotoLine line %d (%+d|%+d)", dif->row_i, i1, i2);
+  trace("<-gotoLine line %lld (%+lld|%+lld)", dif->row_i, i1, i2);
 
   return c1 == EOF || c2 == EOF ? EOF : !EOF;
 }
@@ -492,9 +1246,14 @@ ndiff_gotoNum (T *dif, const C *c)
 {
   assert(dif && c);
 
-  trace("->gotoNum line %d", dif->row_i);
+  trace("->gotoNum line %lld", dif->row_i);
+
+  ndiff_endLine(dif);
 
-  int c1=0, c2=0, i1=0, i2=0;
+  int c1=0, c2=0;
+  llong i1=0, i2=0;
+  llong max = ndiff_gotoMax(dif, c);
+  bool  f1 = false, f2 = false;
   C _c = *c;
 
   if (c->eps.gto_reg)
@@ -503,6 +1262,10 @@ ndiff_gotoNum (T *dif, const C *c)
   if ((c->eps.cmd & eps_equ) && slice_isFull(&c->col))
     return ndiff_gotoLine(dif, &_c);
 
+  // positions to restore if the number is not found within the limit
+  llong p1 = max ? ftello(dif->lhs_f) : -1;
+  llong p2 = max ? ftello(dif->rhs_f) : -1;
+
   // --- lhs ---
   memcpy(dif->rhs_b, _c.eps.tag, sizeof _c.eps.tag);
 
@@ -515,23 +1278,26 @@ ndiff_gotoNum (T *dif, const C *c)
     if (c1 == EOF) break;
 
     while (1) {
-      c1 = readLine(dif->lhs_f, dif->lhs_b+s1, dif->buf_n-s1, &s1);
+      c1 = readLineFast(dif->lhs_f, dif->lhs_b+s1, dif->buf_n-s1, &s1);
       if (c1 == '\n' || c1 == EOF) break;
       ndiff_grow(dif, 2*dif->buf_n);
     }
 
     i1 += 1;
-    trace("  lhs[%d]: '%s'", dif->row_i+i1, dif->lhs_b);
+    STATS_ADD(dif, lhs_bytes, s1 + (c1 == '\n'));
+    trace("  lhs[%lld]: '%s'", dif->row_i+i1, dif->lhs_b);
 
     // search for number
-    int col = 0;
+    llong col = 0;
     for (dif->rhs_i=0; (col = ndiff_nextNum(dif, &_c)); dif->rhs_i=0) {
       if (slice_isElem(&_c.col, col)) {
-        if (ndiff_testNum(dif, &_c) == 0) goto lhs_done;
+        if (ndiff_testNum(dif, &_c) == 0) { f1 = true; goto lhs_done; }
       }
       else
         dif->lhs_i += parse_number(dif->lhs_b+dif->lhs_i, 0,0,0,0);
     }
+
+    if (i1 == max) break;
   }
 lhs_done: ;
 
@@ -548,55 +1314,63 @@ lhs_done: ;
     dif->rhs_i    = 0;
     dif->rhs_b[0] = 0;
 
-    if (c2 == EOF) break;
+    if (c2 == EOF || (max && !f1)) break;
 
     while (1) {
-      c2 = readLine(dif->rhs_f, dif->rhs_b+s2, dif->buf_n-s2, &s2);
+      c2 = readLineFast(dif->rhs_f, dif->rhs_b+s2, dif->buf_n-s2, &s2);
       if (c2 == '\n' || c2 == EOF) break;
       ndiff_grow(dif, 2*dif->buf_n);
     }
 
     i2 += 1;
-    trace("  rhs[%d]: '%s'", dif->row_i+i2, dif->rhs_b);
+    STATS_ADD(dif, rhs_bytes, s2 + (c2 == '\n'));
+    trace("  rhs[%lld]: '%s'", dif->row_i+i2, dif->rhs_b);
 
     // search for number
-    int col = 0;
+    llong col = 0;
     for (dif->lhs_i=0; (col = ndiff_nextNum(dif, &_c)); dif->lhs_i=0) {
       if (slice_isElem(&_c.col, col)) {
-        if (ndiff_testNum(dif, &_c) == 0) goto rhs_done;
+        if (ndiff_testNum(dif, &_c) == 0) { f2 = true; goto rhs_done; }
       }
       else
         dif->rhs_i += parse_number(dif->rhs_b+dif->rhs_i, 0,0,0,0);
     }
+
+    if (i2 == max) break;
   }
 rhs_done: ;
   memcpy(dif->lhs_b, tag, sizeof tag);
 
+  if (max && !(f1 && f2))
+    return ndiff_gotoFail(dif, &_c, p1, p2, i1, i2, f1, f2);
+
   dif->lhs_i  = 0;
   dif->rhs_i  = 0;
   dif->col_i  = 0;
-  dif->row_i += imin(i1,i2);
+  dif->row_i += i1 < i2 ? i1 : i2;
 
   // return with last lhs and rhs lines loaded
 
+  FLIGHT(dif, flight_goto, dif->row_i, 0, i1, i2, c->idx, c->line, 0, 0, 0);
+
   trace("  buffers: '%.25s'|'%.25s'", dif->lhs_b, dif->rhs_b);
-  trace("<-gotoNum line %d (%+d|%+d)", dif->row_i, i1, i2);
+  trace("<-gotoNum line %lld (%+lld|%+lld)", dif->row_i, i1, i2);
 
   return c1 == EOF || c2 == EOF ? EOF : !EOF;
 }
 
 // this function is overcomplicated and should be rewritten using true parsers
 // or at least a different strategy...
-int
-ndiff_nextNum (T *dif, const C *c)
+NDIFF_TPL llong
+ndiff_nextNum_tpl (T *dif, const C *c, const bool slow)
 {
   assert(dif);
 
   char *restrict lhs_p = dif->lhs_b+dif->lhs_i;
   char *restrict rhs_p = dif->rhs_b+dif->rhs_i;
 
-  trace("->nextNum  line %d, column %d, char-column %d|%d", dif->row_i, dif->col_i, dif->lhs_i, dif->rhs_i);
-  trace("  strings: '%.25s'|'%.25s'", lhs_p, rhs_p);
+  TRACE("->nextNum  line %lld, column %lld, char-column %d|%d", dif->row_i, dif->col_i, dif->lhs_i, dif->rhs_i);
+  TRACE("  strings: '%.25s'|'%.25s'", lhs_p, rhs_p);
 
   if (ndiff_isempty(dif)) goto quit_str;
 
@@ -613,13 +1387,19 @@ retry:
       ++lhs_p, ++rhs_p;
 
     // skip whitespaces differences
-    if (dif->blank && (isblank(*lhs_p) || isblank(*rhs_p))) {
+    if (slow && dif->blank && (isblank(*lhs_p) || isblank(*rhs_p))) {
       while (isblank(*lhs_p)) ++lhs_p;
       while (isblank(*rhs_p)) ++rhs_p;
       goto retry;
     }
   }
 
+  // end of window, slide over the line
+  if (ndiff_winEnd(dif, lhs_p, rhs_p)) {
+    ndiff_slide(dif, &lhs_p, &rhs_p);
+    goto retry;
+  }
+
   // end-of-line
   if (!*lhs_p && !*rhs_p)
     goto quit_str;
@@ -632,7 +1412,7 @@ retry:
   lhs_p = backtrack_number(lhs_p, dif->lhs_b);
   rhs_p = backtrack_number(rhs_p, dif->rhs_b);
 
-  trace("  backtracking numbers '%.25s'|'%.25s'", lhs_p, rhs_p);
+  TRACE("  backtracking numbers '%.25s'|'%.25s'", lhs_p, rhs_p);
 
   // at the start of a number?
   if (!is_number_start(lhs_p, dif->lhs_b) || !is_number_start(rhs_p, dif->rhs_b)) {
@@ -646,9 +1426,9 @@ retry:
       if (c->eps.cmd & eps_omit)
         strict = !is_valid_omit(lhs_p, rhs_p, dif, c->eps.tag);
       int j = strict ? 0 : strlen(c->eps.tag);
-      trace("  %s strings[0-%d] '%.25s'|'%.25s'", strict ? "skipping" : "omitting", j, lhs_p-j, rhs_p-j);
+      TRACE("  %s strings[0-%d] '%.25s'|'%.25s'", strict ? "skipping" : "omitting", j, lhs_p-j, rhs_p-j);
       skip_identifier(&lhs_p, &rhs_p, strict);
-      trace("  strings [%d] '%.25s'|'%.25s'", strict, lhs_p, rhs_p);
+      TRACE("  strings [%d] '%.25s'|'%.25s'", strict, lhs_p, rhs_p);
       if (!isdigit(*lhs_p) || !isdigit(*rhs_p)) goto retry;
       goto quit_diff;
     }
@@ -657,29 +1437,43 @@ retry:
   // numbers found
   dif->lhs_i = lhs_p-dif->lhs_b;
   dif->rhs_i = rhs_p-dif->rhs_b;
-  trace("  strnums: '%.25s'|'%.25s'", lhs_p, rhs_p);
-  trace("<-nextNum  line %d, column %d, char-column %d|%d", dif->row_i, dif->col_i, dif->lhs_i, dif->rhs_i);
+  FLIGHT(dif, flight_num, dif->row_i, dif->col_i+1, dif->lhs_o+dif->lhs_i, dif->rhs_o+dif->rhs_i, c->idx, c->line, 0, 0, 0);
+  TRACE("  strnums: '%.25s'|'%.25s'", lhs_p, rhs_p);
+  TRACE("<-nextNum  line %lld, column %lld, char-column %d|%d", dif->row_i, dif->col_i, dif->lhs_i, dif->rhs_i);
   return ++dif->num_i, ++dif->col_i;
 
 quit_diff:
   dif->lhs_i = lhs_p-dif->lhs_b+1;
   dif->rhs_i = rhs_p-dif->rhs_b+1;
+  if (dif->prof && !(c->eps.cmd & eps_nofail)) dif->prof[c->idx].fails++;
+  FLIGHT(dif, flight_str, dif->row_i, 0, dif->lhs_o+dif->lhs_i, dif->rhs_o+dif->rhs_i, c->idx, c->line, 1, 0, 0);
   if (!(c->eps.cmd & eps_nofail) && ++dif->cnt_i <= dif->max_i) {
-    if (dif->cnt_i == 1) ndiff_header();
-    warning("(%d) files differ at line %d and char-columns %d|%d", dif->cnt_i, dif->row_i, dif->lhs_i, dif->rhs_i);
-    warning("(%d) strings: '%.25s'|'%.25s'", dif->cnt_i, lhs_p, rhs_p);
+    if (dif->cnt_i == 1) ndiff_header(dif);
+    if (dif->rep) {
+      struct report_rec r = {
+        .cnt = dif->cnt_i, .row = dif->row_i, .lhs_i = dif->lhs_o+dif->lhs_i, .rhs_i = dif->rhs_o+dif->rhs_i,
+        .lhs_p = lhs_p, .lhs_n = strlen25(lhs_p), .rhs_p = rhs_p, .rhs_n = strlen25(rhs_p),
+        .rule = c->idx, .line = c->line
+      };
+      report_str(dif->rep, &r);
+    } else {
+      warning("(%lld) files differ at line %lld and char-columns %lld|%lld", dif->cnt_i, dif->row_i,
+              dif->lhs_o+dif->lhs_i, dif->rhs_o+dif->rhs_i);
+      warning("(%lld) strings: '%.25s'|'%.25s'", dif->cnt_i, lhs_p, rhs_p);
+    }
+    if (dif->fr) flight_dump(dif->fr, stderr);
   }
   if (c->eps.cmd & eps_onfail) context_onfail(dif->cxt, c);
 
 quit_str:
   dif->lhs_i = lhs_p-dif->lhs_b+1;
   dif->rhs_i = rhs_p-dif->rhs_b+1;
-  trace("<-nextNum  line %d, column %d, char-column %d|%d", dif->row_i, dif->col_i, dif->lhs_i, dif->rhs_i);
+  TRACE("<-nextNum  line %lld, column %lld, char-column %d|%d", dif->row_i, dif->col_i, dif->lhs_i, dif->rhs_i);
   return dif->col_i = 0;
 }
 
-int
-ndiff_testNum (T *dif, const C *c)
+NDIFF_TPL int
+ndiff_testNum_tpl (T *dif, const C *c, const bool slow)
 {
   assert(dif && c);
 
@@ -692,8 +1486,8 @@ ndiff_testNum (T *dif, const C *c)
   int ri = context_findIdx (dif->cxt, c);
   int rl = context_findLine(dif->cxt, c);
 
-  trace("->testNum  line %d, column %d, char-column %d|%d", dif->row_i, dif->col_i, dif->lhs_i, dif->rhs_i);
-  trace("  strnums: '%.25s'|'%.25s'", lhs_p, rhs_p);
+  TRACE("->testNum  line %lld, column %lld, char-column %d|%d", dif->row_i, dif->col_i, dif->lhs_i, dif->rhs_i);
+  TRACE("  strnums: '%.25s'|'%.25s'", lhs_p, rhs_p);
 
   // parse numbers
   int d1=0, d2=0, n1=0, n2=0, e1=0, e2=0, f1=0, f2=0;
@@ -701,6 +1495,8 @@ ndiff_testNum (T *dif, const C *c)
   int l2 = parse_number(rhs_p, &d2, &n2, &e2, &f2);
   int ret = 0;
 
+  STATS_ADD(dif, tests, 1);
+
   // save R1 and R2 from input
   reg_setval(dif->reg, dif->reg_n, 1, lhs_d = strtod(c->eps.cmd & eps_swap ? rhs_p : lhs_p, 0));
   reg_setval(dif->reg, dif->reg_n, 2, rhs_d = strtod(c->eps.cmd & eps_swap ? lhs_p : rhs_p, 0));
@@ -723,7 +1519,7 @@ ndiff_testNum (T *dif, const C *c)
   rel_d = abs_d/ min_d;
   dig_d = abs_d/(min_d*pow_d);
 
-  trace("  values: lhs_d=%.2g, rhs_d=%.2g, scl_d=%.2g, off_d=%.2g, min_d=%.2g, pow_d=%.2g, abs_d=%.2g, rel_d=%.2g, dig_d=%.2g",
+  TRACE("  values: lhs_d=%.2g, rhs_d=%.2g, scl_d=%.2g, off_d=%.2g, min_d=%.2g, pow_d=%.2g, abs_d=%.2g, rel_d=%.2g, dig_d=%.2g",
            lhs_d, rhs_d, scl_d, off_d, min_d, pow_d, abs_d, rel_d, dig_d);
 
   // save R3..R9
@@ -738,7 +1534,7 @@ ndiff_testNum (T *dif, const C *c)
   // missing numbers
   if (!l1 || !l2) {
     if ((c->eps.cmd & (eps_ign | eps_istr)) == (eps_ign | eps_istr)) {
-      trace("  missing numbers (rule #%d, line %d) '%.25s'|'%.25s' (%d|%d)", ri, rl, lhs_p, rhs_p, l1, l2);
+      TRACE("  missing numbers (rule #%d, line %d) '%.25s'|'%.25s' (%d|%d)", ri, rl, lhs_p, rhs_p, l1, l2);
       goto quit;
     }
 
@@ -748,14 +1544,14 @@ ndiff_testNum (T *dif, const C *c)
 
   // ignore difference
   if (c->eps.cmd & eps_ign) {
-    trace("  ignoring numbers (rule #%d, line %d) '%.25s'|'%.25s' (%d|%d)", ri, rl, lhs_p, rhs_p, l1, l2);
+    TRACE("  ignoring numbers (rule #%d, line %d) '%.25s'|'%.25s' (%d|%d)", ri, rl, lhs_p, rhs_p, l1, l2);
     goto quit;
   }
 
   // omit difference
   if (c->eps.cmd & eps_omit) {
     if (is_valid_omit(lhs_p, rhs_p, dif, c->eps.tag)) {
-      trace("  omitting numbers (rule #%d, line %d) '%.25s'|'%.25s' (%d|%d)", ri, rl, lhs_p, rhs_p, l1, l2);
+      TRACE("  omitting numbers (rule #%d, line %d) '%.25s'|'%.25s' (%d|%d)", ri, rl, lhs_p, rhs_p, l1, l2);
       goto quit;
     }
   }
@@ -765,7 +1561,7 @@ ndiff_testNum (T *dif, const C *c)
     if (l1 != l2 || memcmp(lhs_p, rhs_p, l1))
       ret |= eps_equ;
 
-    trace("  strict comparison failed (rule #%d, line %d) '%.25s'|'%.25s' (%d|%d)", ri, rl, lhs_p, rhs_p, l1, l2);
+    TRACE("  strict comparison failed (rule #%d, line %d) '%.25s'|'%.25s' (%d|%d)", ri, rl, lhs_p, rhs_p, l1, l2);
     if (ret) goto quit_diff;
     else     goto quit;
   }
@@ -796,68 +1592,109 @@ ndiff_testNum (T *dif, const C *c)
   }
 
   if ((c->eps.cmd & eps_any) && (ret & eps_dra) != (c->eps.cmd & eps_dra)) {
-    trace("  any dra success (rule #%d, line %d) '%.25s'|'%.25s' (%d|%d)", ri, rl, lhs_p, rhs_p, l1, l2);
-    trace("  any dra success flags %s [%s|%s|%s] ", (f1 || f2) ? "floating" : "integer",
+    TRACE("  any dra success (rule #%d, line %d) '%.25s'|'%.25s' (%d|%d)", ri, rl, lhs_p, rhs_p, l1, l2);
+    TRACE("  any dra success flags %s [%s|%s|%s] ", (f1 || f2) ? "floating" : "integer",
              ret & eps_abs ? "-" : "abs", ret & eps_rel ? "-" : "rel", ret & eps_dig ? "-" : "dig");
     ret = 0;
   }
 
+  ERRSTATS(dif, dif->row_i, ri, dif->col_i, abs_d, rel_d, dig_d, ret != 0);
+
   if (!ret) goto quit;
 
 quit_diff:
+  FLIGHT(dif, flight_test, dif->row_i, dif->col_i, dif->lhs_o+dif->lhs_i, dif->rhs_o+dif->rhs_i, ri, rl, ret, lhs_d, rhs_d);
   if (!(c->eps.cmd & eps_nofail) && ++dif->cnt_i <= dif->max_i) {
-    if (dif->cnt_i == 1) ndiff_header();
-    warning("(%d) files differ at line %d column %d between char-columns %d|%d and %d|%d",
-            dif->cnt_i, dif->row_i, dif->col_i, dif->lhs_i+1, dif->rhs_i+1, dif->lhs_i+1+l1, dif->rhs_i+1+l2);
+    if (dif->cnt_i == 1) ndiff_header(dif);
+    if (dif->rep) {
+      struct report_rec r = {
+        .cnt = dif->cnt_i, .row = dif->row_i, .col = dif->col_i,
+        .lhs_i = dif->lhs_o+dif->lhs_i, .rhs_i = dif->rhs_o+dif->rhs_i,
+        .lhs_p = lhs_p, .lhs_n = l1, .rhs_p = rhs_p, .rhs_n = l2,
+        .fail = ret, .rule = ri, .line = rl, .ndig = imax(n1, n2),
+        .abs_d = abs_d, .rel_d = rel_d,
+        .abs = { _abs, abs }, .rel = { _rel, rel }, .dig = { _dig*pow_d, dig*pow_d }
+      };
+      report_num(dif->rep, &r);
+      goto quit_report;
+    }
 
-    char str[128];
-    sprintf(str, "(%%d) numbers: '%%.%ds'|'%%.%ds'", l1, l2);
-    warning(str, dif->cnt_i, lhs_p, rhs_p);
+    { llong i1 = dif->lhs_o+dif->lhs_i+1, i2 = dif->rhs_o+dif->rhs_i+1;
+      warning("(%lld) files differ at line %lld column %lld between char-columns %lld|%lld and %lld|%lld",
+              dif->cnt_i, dif->row_i, dif->col_i, i1, i2, i1+l1, i2+l2);
+    }
+
+    warning("(%lld) numbers: '%.*s'|'%.*s'", dif->cnt_i, l1, lhs_p, l2, rhs_p);
 
     if (ret & eps_ign)
-      warning("(%d) one number is missing (column count can be wrong)", dif->cnt_i);
+      warning("(%lld) one number is missing (column count can be wrong)", dif->cnt_i);
 
     if (ret & eps_equ)
-      warning("(%d) numbers strict representation differ (rule #%d, line %d)", dif->cnt_i, ri, rl);
+      warning("(%lld) numbers strict representation differ (rule #%d, line %d)", dif->cnt_i, ri, rl);
 
     if (ret & eps_abs)
-      warning("(%d) absolute error (rule #%d, line %d: %.2g<=abs<=%.2g) abs=%.2g, rel=%.2g, ndig=%d",
+      warning("(%lld) absolute error (rule #%d, line %d: %.2g<=abs<=%.2g) abs=%.2g, rel=%.2g, ndig=%d",
               dif->cnt_i, ri, rl, _abs, abs, abs_d, rel_d, imax(n1, n2));
 
     if (ret & eps_rel)
-      warning("(%d) relative error (rule #%d, line %d: %.2g<=rel<=%.2g) abs=%.2g, rel=%.2g, ndig=%d",
+      warning("(%lld) relative error (rule #%d, line %d: %.2g<=rel<=%.2g) abs=%.2g, rel=%.2g, ndig=%d",
               dif->cnt_i, ri, rl, _rel, rel, abs_d, rel_d, imax(n1, n2));
 
     if (ret & eps_dig)
-      warning("(%d) numdigit error (rule #%d, line %d: %.2g<=rel<=%.2g) abs=%.2g, rel=%.2g, ndig=%d",
+      warning("(%lld) numdigit error (rule #%d, line %d: %.2g<=rel<=%.2g) abs=%.2g, rel=%.2g, ndig=%d",
               dif->cnt_i, ri, rl, _dig*pow_d, dig*pow_d, abs_d, rel_d, imax(n1, n2));
+
+quit_report:
+    if (dif->fr) flight_dump(dif->fr, stderr);
   }
   if (c->eps.cmd & eps_onfail) context_onfail(dif->cxt, c);
 
 quit:
+  if (!ret) FLIGHT(dif, flight_test, dif->row_i, dif->col_i, dif->lhs_o+dif->lhs_i, dif->rhs_o+dif->rhs_i, ri, rl, 0, lhs_d, rhs_d);
+  STATS_LAP(dif, stats_test);
+
+  if (slow && dif->canon && !ret) {
+    ndiff_canonNum(dif, c, 0, lhs_p, l1, n1, f1, fmax(abs, -_abs), fmax(rel, -_rel), fmax(dig, -_dig));
+    ndiff_canonNum(dif, c, 1, rhs_p, l2, n2, f2, fmax(abs, -_abs), fmax(rel, -_rel), fmax(dig, -_dig));
+  }
+
   if (!ret || c->eps.cmd & eps_eval) {
     // operations with registers and trace
-    if (c->eps.cmd & eps_traceR)
+    if (slow && c->eps.cmd & eps_traceR)
       ndiff_traceR(dif, c, true, lhs_d, rhs_d, scl_d, off_d, abs, _abs, rel, _rel, dig, _dig);
 
     // operations (only)
     else
       for (int i=0; i < c->eps.op_n; i++)
-        reg_eval(dif->reg, dif->reg_n, c->eps.dst[i], c->eps.src[i], c->eps.src2[i], c->eps.op[i]);
+        ndiff_regEval(dif, c, i);
   }
   else {
     // trace registers (only)
-    if (c->eps.cmd & eps_traceR)
+    if (slow && c->eps.cmd & eps_traceR)
       ndiff_traceR(dif, c, false, lhs_d, rhs_d, scl_d, off_d, abs, _abs, rel, _rel, dig, _dig);
   }
 
+  STATS_LAP(dif, stats_reg);
+
   dif->lhs_i += l1;
   dif->rhs_i += l2;
-  trace("<-testNum  line %d, column %d, char-column %d|%d", dif->row_i, dif->col_i, dif->lhs_i, dif->rhs_i);
+  TRACE("<-testNum  line %lld, column %lld, char-column %d|%d", dif->row_i, dif->col_i, dif->lhs_i, dif->rhs_i);
 
   return ret;
 }
 
+llong
+ndiff_nextNum (T *dif, const C *c)
+{
+  return ndiff_nextNum_tpl(dif, c, true);
+}
+
+int
+ndiff_testNum (T *dif, const C *c)
+{
+  return ndiff_testNum_tpl(dif, c, true);
+}
+
 void
 ndiff_option  (T *dif, const int *keep_, const int *blank_, const int *check_, const int *recycle_)
 {
@@ -868,18 +1705,168 @@ ndiff_option  (T *dif, const int *keep_, const int *blank_, const int *check_, c
   if (check_)   dif->check   = *check_;
   if (recycle_) dif->recycle = *recycle_;
 
+  ndiff_select(dif);
+
   ensure(dif->max_i > 0, "number of kept diff must be positive");
 }
 
+void
+ndiff_canon (T *dif, int canon)
+{
+  assert(dif);
+  dif->canon = canon;
+  ndiff_select(dif);
+}
+
 void
 ndiff_result (T *dif, FILE *lhs_rfp, FILE *rhs_rfp)
 {
+  writer_free(dif->lhs_w);
+  writer_free(dif->rhs_w);
   dif->lhs_r = lhs_rfp;
   dif->rhs_r = rhs_rfp;
+  dif->lhs_w = lhs_rfp ? writer_alloc(lhs_rfp) : 0;
+  dif->rhs_w = rhs_rfp ? writer_alloc(rhs_rfp) : 0;
+}
+
+void
+ndiff_stats (T *dif, struct stats *sta)
+{
+  assert(dif);
+  dif->sta = sta;
+  if (sta && sta->buf_max < dif->buf_n) sta->buf_max = dif->buf_n;
+}
+
+void
+ndiff_flight (T *dif, struct flight *fr)
+{
+  assert(dif);
+  dif->fr = fr;
+}
+
+void
+ndiff_report (T *dif, struct report *rep)
+{
+  assert(dif);
+  dif->rep = rep;
+}
+
+void
+ndiff_window (T *dif, int win)
+{
+  assert(dif);
+  ensure(!win || win >= win_min, "window must be at least %d chars", win_min);
+  dif->win = win;
+}
+
+void
+ndiff_within (T *dif, llong max)
+{
+  assert(dif);
+  ensure(max >= 0, "invalid goto search limit %lld", max);
+  dif->gto_max = max;
 }
 
 void
-ndiff_getInfo (const T *dif, int *row_, int *col_, int *cnt_, long *num_)
+ndiff_async (T *dif, llong lines)
+{
+  assert(dif);
+  ensure(lines >= 0, "invalid goto concurrent search threshold %lld", lines);
+  dif->gto_asy = lines;
+}
+
+void
+ndiff_rows (T *dif, llong first, llong last)
+{
+  assert(dif);
+  ensure(first > 0 && (!last || last >= first), "invalid region of rows %lld-%lld", first, last);
+
+  const C *c;
+
+  dif->row_f = first;
+  dif->row_l = last;
+
+  // rows before the region are neither read nor evaluated
+  for (int i = 0; dif->cxt && (c = context_getIdx(dif->cxt, i)); i++) {
+    const struct eps *e = &c->eps;
+    if (slice_first(&c->row) >= (ullong)first) continue;
+    if (e->op_n)
+      warning("rule #%d (line %d) updates registers before row %lld, their values are unknown in the region",
+              i, context_findLine(dif->cxt, c), first);
+    if (e->cmd & (eps_goto | eps_gonum))
+      warning("rule #%d (line %d) moves inputs before row %lld, the region may be misaligned",
+              i, context_findLine(dif->cxt, c), first);
+  }
+}
+
+void
+ndiff_cols (T *dif, llong first, llong last)
+{
+  assert(dif);
+  ensure(first > 0 && (!last || last >= first), "invalid region of columns %lld-%lld", first, last);
+
+  dif->col_f = first;
+  dif->col_l = last ? last : LLONG_MAX;
+}
+
+void
+ndiff_incr (T *dif, struct incr *inc, llong rows)
+{
+  assert(dif);
+
+  // blocks are reread for their digests and skipped by seeking
+  if (inc && (ftello(dif->lhs_f) < 0 || ftello(dif->rhs_f) < 0)) {
+    warning("incremental mode requires seekable input files, ignored");
+    inc = 0;
+  }
+
+  dif->inc      = inc;
+  dif->inc_rows = rows > 0 ? rows : incr_rows;
+  dif->inc_row  = 0;
+}
+
+void
+ndiff_sample (T *dif, double rate, ullong seed)
+{
+  assert(dif);
+  ensure(rate > 0 && rate <= 1, "invalid sampling rate %g", rate);
+
+  const C *c;
+
+  dif->smp_thr = rate < 1 ? (ullong)(rate * 18446744073709551616.0) : 0;
+  dif->smp_key = ndiff_hash(seed);
+  dif->smp_rf  = ULLONG_MAX;
+  dif->smp_rl  = 0;
+
+  // rows of rules loading or updating registers are never sampled out
+  for (int i = 0; dif->cxt && (c = context_getIdx(dif->cxt, i)); i++) {
+    const struct eps *e = &c->eps;
+    if (!(e->op_n || e->lhs_reg || e->rhs_reg || e->scl_reg || e->off_reg ||
+          e->abs_reg || e->rel_reg || e->dig_reg || e->_abs_reg || e->_rel_reg ||
+          e->_dig_reg || e->gto_reg)) continue;
+    if (dif->smp_rf > slice_first(&c->row)) dif->smp_rf = slice_first(&c->row);
+    if (dif->smp_rl < slice_last (&c->row)) dif->smp_rl = slice_last (&c->row);
+  }
+}
+
+void
+ndiff_getSample (const T *dif, llong *rows_, llong *skip_)
+{
+  assert(dif);
+
+  if (rows_) *rows_ = dif->smp_rows;
+  if (skip_) *skip_ = dif->smp_skip;
+}
+
+void
+ndiff_errstats (T *dif, struct errstats *es)
+{
+  assert(dif);
+  dif->es = es;
+}
+
+void
+ndiff_getInfo (const T *dif, llong *row_, llong *col_, llong *cnt_, llong *num_)
 {
   assert(dif);
 
@@ -894,6 +1881,9 @@ ndiff_feof (const T *dif, int both)
 {
   assert(dif);
 
+  if (dif->stop) return true;
+  if (dif->row_l && dif->row_i >= dif->row_l) return true;
+
   return both ? feof(dif->lhs_f) && feof(dif->rhs_f)
               : feof(dif->lhs_f) || feof(dif->rhs_f);
 }
@@ -903,44 +1893,196 @@ ndiff_isempty (const T *dif)
 {
   assert(dif);
 
-  return !dif->lhs_b[dif->lhs_i] && !dif->rhs_b[dif->rhs_i];
+  return !dif->lhs_b[dif->lhs_i] && !dif->rhs_b[dif->rhs_i] && !dif->lhs_more && !dif->rhs_more;
+}
+
+// --- incremental mode ------------------------------------------------------
+
+// digest of the rules state changed by the onfail of failed rules (alt qualifiers)
+static ullong
+ndiff_incrState (const T *dif)
+{
+  ullong h = 0xcbf29ce484222325ULL;
+  const C *c;
+
+  for (int i = 0; dif->cxt && (c = context_getIdx(dif->cxt, i)); i++)
+    if (c->eps.cmd & eps_alt) h = incr_hash(h, &i, sizeof i);
+
+  return h;
+}
+
+// open a block at the current row and offsets
+static void
+ndiff_incrOpen (T *dif, llong lo, llong ro)
+{
+  if (!dif->inc_b.reg) {
+    dif->inc_b.reg = malloc(dif->reg_n * sizeof *dif->inc_b.reg);
+    ensure(dif->inc_b.reg, "out of memory");
+  }
+
+  dif->inc_b.row   = dif->row_i;
+  dif->inc_b.cxt_h = ndiff_incrState(dif);
+  dif->inc_b.reg_n = dif->reg_n;
+  memcpy(dif->inc_b.reg, dif->reg, dif->reg_n * sizeof *dif->reg);
+
+  dif->inc_lo  = lo,         dif->inc_ro  = ro;
+  dif->inc_cnt = dif->cnt_i, dif->inc_num = dif->num_i;
+  dif->inc_open = true;
+}
+
+// close the block at offsets lo|ro, only the clean blocks need digests,
+// a block revealing alt rules (onfail) changes the next ones, it is not clean
+static void
+ndiff_incrClose (T *dif, llong lo, llong ro, bool last)
+{
+  struct incr_blk *b = &dif->inc_b;
+
+  b->rows  = dif->row_i - b->row;
+  b->nums  = dif->num_i - dif->inc_num;
+  b->clean = !last && dif->cnt_i == dif->inc_cnt && ndiff_incrState(dif) == b->cxt_h;
+  b->lhs_n = lo - dif->inc_lo, b->lhs_h = 0;
+  b->rhs_n = ro - dif->inc_ro, b->rhs_h = 0;
+
+  if (b->clean) {
+    b->lhs_h = incr_digest(dif->lhs_f, dif->inc_lo, b->lhs_n);
+    b->rhs_h = incr_digest(dif->rhs_f, dif->inc_ro, b->rhs_n);
+  }
+
+  incr_add(dif->inc, b, false);
+  dif->inc_open = false;
+}
+
+// block boundary: close the diffed block, reuse the outcomes of the unchanged
+// clean blocks of the previous run (same row, rules state, registers and bytes), open the next one
+static void
+ndiff_incrStep (T *dif)
+{
+  const struct incr_blk *p, *q;
+  llong lo = ftello(dif->lhs_f), ro = ftello(dif->rhs_f);
+
+  ensure(lo >= 0 && ro >= 0, "unable to locate input files");
+
+  if (dif->inc_open) ndiff_incrClose(dif, lo, ro, false);
+
+  ullong cxt_h = ndiff_incrState(dif);
+
+  while ((p = incr_find(dif->inc, dif->row_i)) && p->clean && (q = incr_next(dif->inc, p)) &&
+         p->cxt_h == cxt_h &&
+         p->reg_n == dif->reg_n && !memcmp(p->reg, dif->reg, dif->reg_n * sizeof *dif->reg) &&
+         incr_digest(dif->lhs_f, lo, p->lhs_n) == p->lhs_h &&
+         incr_digest(dif->rhs_f, ro, p->rhs_n) == p->rhs_h) {
+    lo += p->lhs_n, ro += p->rhs_n;
+    ensure(!fseeko(dif->lhs_f, lo, SEEK_SET) && !fseeko(dif->rhs_f, ro, SEEK_SET),
+           "unable to seek input files");
+
+    dif->row_i += p->rows;
+    dif->num_i += p->nums;
+    memcpy(dif->reg, q->reg, dif->reg_n * sizeof *dif->reg);
+    incr_add(dif->inc, p, true);
+
+    trace("  block of %lld rows reused at line %lld", p->rows, p->row);
+  }
+
+  ndiff_incrOpen(dif, lo, ro);
+  dif->inc_row = (dif->row_i / dif->inc_rows + 1) * dif->inc_rows;
+}
+
+// end of diff, the last block is kept for the registers at its beginning
+static void
+ndiff_incrEnd (T *dif)
+{
+  if (dif->inc_open) ndiff_incrClose(dif, dif->inc_lo, dif->inc_ro, true);
 }
 
 // --- main ndiff loop --------------------------------------------------------
 
-void
-ndiff_loop(T *dif)
+NDIFF_TPL int
+ndiff_testProf (T *dif, const C *c, bool sampled, const bool slow)
+{
+  struct context_prof *p = dif->prof + c->idx;
+  double t0 = sampled ? stats_now() : 0;
+
+  int ret = ndiff_testNum_tpl(dif, c, slow);
+
+  if (sampled) p->time += (stats_now() - t0) * STATSAMPLE;
+  p->nums  += 1;
+  p->fails += ret && !(c->eps.cmd & eps_nofail);
+
+  return ret;
+}
+
+NDIFF_TPL void
+ndiff_loop_tpl (T *dif, const bool slow)
 {
   assert(dif);
 
   const C *c, *c2;
-  int row=0, col, ret;
+  llong row=dif->row_i, col;
+  int ret;
   int saved_level = logmsg_config.level;
+  bool sampled = false;
+
+  dif->prof = context_getProf(dif->cxt);
 
 recycle:
 
   while(!ndiff_feof(dif, 0)) {
+    // block boundary of the incremental mode
+    if (!slow && dif->inc && row >= dif->inc_row) {
+      ndiff_incrStep(dif);
+      ndiff_getInfo(dif, &row, 0, 0, 0);
+    }
+
     ++row, col=0, ret=0;
 
+    if (dif->sta ) stats_row(dif->sta, row);
+    if (dif->prof) sampled = !((row-1) & (STATSAMPLE-1));
+
     c = context_getInc(dif->cxt, row, col);
     ensure(c, "invalid context");
-    if (dif->check && c != (c2 = context_getAt(dif->cxt, row, col)))
+    if (slow && dif->check && c != (c2 = context_getAt(dif->cxt, row, col)))
       ndiff_error(dif->cxt, c, c2, row, col);
 
+    STATS_LAP(dif, stats_rule);
+
+    if (dif->prof && c->eps.cmd & eps_sgg) dif->prof[c->idx].acts++;
+    if (c->eps.cmd & eps_sgg) FLIGHT(dif, flight_rule, row, 0, 0, 0, c->idx, c->line, 0, 0, 0);
+
     // trace rule
-    if (c->eps.cmd & eps_trace && c->eps.cmd & eps_sgg) {
+    if (slow && c->eps.cmd & eps_trace && c->eps.cmd & eps_sgg) {
       logmsg_config.level = trace_level;
       trace("~>active:  rule #%d, line %d, cmd = %d",
             context_findIdx(dif->cxt,c), context_findLine(dif->cxt,c), c->eps.cmd);
       logmsg_config.level = saved_level;
     }
 
-    // skip this line
+    // skip this line, or all the lines of a dense skip rule at once
     if (c->eps.cmd & eps_skip) {
-      ndiff_skipLine(dif);
+      llong n = slow || dif->fr ? 0 : context_lastRow(dif->cxt, c) - row;
+      if (n <= 0) ndiff_skipLine(dif);
+      else {
+        ndiff_skipLines(dif, n+1);
+        if (dif->prof) {
+          dif->prof[c->idx].rows += n;
+          if (c->eps.cmd & eps_sgg) dif->prof[c->idx].acts += n;
+        }
+        ndiff_getInfo(dif, &row, 0, 0, 0);
+      }
+      STATS_LAP(dif, stats_read);
       continue;
     }
 
+    // skip the rows not sampled (honor actions and registers)
+    if (dif->smp_thr && !(c->eps.cmd & eps_sgg)) {
+      dif->smp_rows++;
+      if (!ndiff_sampled(dif, row)) {
+        dif->smp_skip++;
+        ndiff_skipLines(dif, 1);
+        STATS_LAP(dif, stats_read);
+        continue;
+      }
+    }
+
     // goto or read line(s)
     if (c->eps.cmd & eps_goto) {
       ndiff_gotoLine(dif, c);
@@ -953,37 +2095,50 @@ recycle:
       ndiff_readLine(dif);
       if (ndiff_isempty(dif)) goto result;
     }
+    STATS_LAP(dif, stats_read);
 
     // for each number column, diff-chars between numbers
-    while((col = ndiff_nextNum(dif, c))) {
+    while((col = ndiff_nextNum_tpl(dif, c, slow))) {
+      STATS_LAP(dif, stats_token);
+
       c = context_getInc(dif->cxt, row, col);
       ensure(c, "invalid context");
-      if (dif->check && c != (c2 = context_getAt(dif->cxt, row, col)))
+      if (slow && dif->check && c != (c2 = context_getAt(dif->cxt, row, col)))
         ndiff_error(dif->cxt, c, c2, row, col);
 
+      STATS_LAP(dif, stats_rule);
+
       // newly activated action
       if (c->eps.cmd & eps_sgg) break;
 
+      // number columns outside the region
+      if (dif->col_f && (col < dif->col_f || col > dif->col_l)) {
+        dif->lhs_i += parse_number(dif->lhs_b+dif->lhs_i, 0,0,0,0);
+        dif->rhs_i += parse_number(dif->rhs_b+dif->rhs_i, 0,0,0,0);
+        continue;
+      }
+
       // trace rule
-      if (c->eps.cmd & eps_trace) {
+      if (slow && c->eps.cmd & eps_trace) {
         logmsg_config.level = trace_level;
         trace("~>active:  rule #%d, line %d, cmd = %d",
               context_findIdx(dif->cxt,c), context_findLine(dif->cxt,c), c->eps.cmd);
       }
 
       // check numbers
-      ret |= ndiff_testNum(dif, c);
+      ret |= dif->prof ? ndiff_testProf(dif, c, sampled, slow) : ndiff_testNum_tpl(dif, c, slow);
 
       // restore logmsg
-      logmsg_config.level = saved_level;
+      if (slow) logmsg_config.level = saved_level;
     }
+    STATS_LAP(dif, stats_token);
 
 result:
     if (!ret) ndiff_outLine(dif);
   }
 
   // recycle file
-  if (dif->recycle) {
+  if (slow && dif->recycle) {
     if (feof(dif->lhs_f) && !feof(dif->rhs_f) && dif->recycle == ndiff_recycle_left) {
       if (fseek(dif->lhs_f, 0, SEEK_SET)) error("unable to recycle left file");
       goto recycle;
@@ -995,10 +2150,51 @@ result:
     }
   }
 
+  if (!slow && dif->inc) ndiff_incrEnd(dif);
+
   if (dif->blank) {
     skipSpace(dif->lhs_f, 0);
     skipSpace(dif->rhs_f, 0);
   }
+
+  if (dif->sta) {
+    STATS_LAP(dif, stats_other);
+    dif->sta->on      = false;
+    dif->sta->lines   = dif->row_i;
+    dif->sta->numbers = dif->num_i;
+  }
+}
+
+// instantiate loop variants
+#define NDIFF_LOOP(NAME, SLOW) \
+  static void NAME (T *dif) { ndiff_loop_tpl(dif, SLOW); }
+
+NDIFF_LOOP(ndiff_loop_fast, false)
+NDIFF_LOOP(ndiff_loop_slow, true )
+
+#undef NDIFF_LOOP
+
+void
+ndiff_loop (T *dif)
+{
+  assert(dif);
+
+  // hold the input streams, the result writers run threads and getc would lock per char
+#ifndef _WIN32
+  flockfile(dif->lhs_f), flockfile(dif->rhs_f);
+  dif->held = true;
+#endif
+
+  // region of rows, skip the rows before at once
+  if (dif->row_f > dif->row_i+1) ndiff_position(dif);
+
+  if (dif->slow) ndiff_loop_slow(dif);
+  else           ndiff_loop_fast(dif);
+
+#ifndef _WIN32
+  dif->held = false;
+  funlockfile(dif->rhs_f), funlockfile(dif->lhs_f);
+#endif
 }
 
 #undef T
@@ -1042,6 +2238,364 @@ ut_testNul(struct utest *utest, T* dif)
   UTEST(dif != 0);
 }
 
+// rows past 2^32 as after a huge skipped prefix (row_i preset), with a dense
+// skip rule on the bulk path and one diff reported after it
+static void
+ut_testHuge(struct utest *utest, T* dif_)
+{
+  (void)dif_;
+
+  FILE *lhs = tmpfile(), *rhs = tmpfile();
+  ensure(lhs && rhs, "unable to create temporary files");
+
+  for (int k = 1; k <= 10; k++) {
+    fprintf(lhs, "%d 1.5 2.5\n", k);
+    fprintf(rhs, "%d 1.5 %s\n", k, k == 4 || k == 8 ? "2.6" : "2.5");
+  }
+  rewind(lhs), rewind(rhs);
+
+  const llong row0 = 4294967296LL - 2;
+  struct context *cxt = context_alloc(0);
+  struct constraint cst;
+
+  // *            *  abs=1e-12
+  cst = constraint_init(slice_initAll(), slice_initAll(), eps_init(eps_abs, 1e-12), -1, 0);
+  cxt = context_add(cxt, &cst);
+  // R+3-R+5      *  skip
+  cst = constraint_init(slice_initLast(row0+3, row0+5), slice_initAll(), eps_init(eps_skip, 0), -1, 0);
+  cxt = context_add(cxt, &cst);
+
+  T *dif = ndiff_alloc(lhs, rhs, cxt, 0, 0);
+  dif->row_i = row0;
+
+  unsigned level = logmsg_config.level;
+  logmsg_config.level = error_level;
+  ndiff_loop(dif);
+  logmsg_config.level = level;
+
+  llong row, cnt, num;
+  ndiff_getInfo(dif, &row, 0, &cnt, &num);
+
+  UTEST(row > row0+10 && row > UINT_MAX);
+  UTEST(cnt == 1);
+  UTEST(num == 7*3);
+
+  ndiff_free(dif);
+  context_free(cxt);
+  fclose(lhs), fclose(rhs);
+}
+
+// sampled rows are deterministic per seed, diffs are only found in them
+static void
+ut_testSample(struct utest *utest, T* dif_)
+{
+  (void)dif_;
+
+  FILE *lhs = tmpfile(), *rhs = tmpfile();
+  ensure(lhs && rhs, "unable to create temporary files");
+
+  for (int k = 1; k <= 1000; k++) {
+    fprintf(lhs, "%d 1.5\n", k);
+    fprintf(rhs, "%d 2.5\n", k);
+  }
+
+  struct constraint cst = constraint_init(slice_initAll(), slice_initAll(), eps_init(eps_abs, 1e-12), -1, 0);
+
+  unsigned level = logmsg_config.level;
+  logmsg_config.level = error_level;
+
+  llong cnt[2], rows[2], skip[2];
+  for (int i = 0; i < 2; i++) {
+    rewind(lhs), rewind(rhs);
+    struct context *cxt = context_add(context_alloc(0), &cst);
+    T *dif = ndiff_alloc(lhs, rhs, cxt, 0, 0);
+    ndiff_sample(dif, 0.25, 42);
+    ndiff_loop(dif);
+    ndiff_getInfo(dif, 0, 0, cnt+i, 0);
+    ndiff_getSample(dif, rows+i, skip+i);
+    ndiff_free(dif);
+    context_free(cxt);
+  }
+
+  logmsg_config.level = level;
+
+  UTEST(cnt[0] == cnt[1] && skip[0] == skip[1]);
+  llong chk = rows[0] - skip[0];
+  UTEST(rows[0] == 1001 && (cnt[0] == chk || cnt[0] == chk-1)); // last row is empty
+  UTEST(cnt[0] > 150 && cnt[0] < 350);
+
+  fclose(lhs), fclose(rhs);
+}
+
+static void
+ut_testCanon(struct utest *utest, T* dif_)
+{
+  (void)dif_;
+
+  FILE *lhs = tmpfile(), *rhs = tmpfile(), *res = tmpfile();
+  ensure(lhs && rhs && res, "unable to create temporary files");
+
+  fputs("x 0.99996 -0.000123450 +007 41.7 1.50D+02 3 4.2000e-7\n", lhs);
+  fputs("x 0.99997 -0.000123451 7 42.2 1.50D+02 9 4.2e-7\n"      , rhs);
+  rewind(lhs), rewind(rhs);
+
+  struct constraint cst[] = {
+    constraint_init(slice_initAll(), slice_initSize(1,2), eps_init(eps_rel, 1e-4), -1, 0),
+    constraint_init(slice_initAll(), slice_initSize(3,2), eps_init(eps_abs, 1.0 ), -1, 0),
+    constraint_init(slice_initAll(), slice_init(5), eps_init(eps_equ, 0   ), -1, 0),
+    constraint_init(slice_initAll(), slice_init(6), eps_init(eps_ign, 0   ), -1, 0),
+  };
+
+  struct context *cxt = context_alloc(0);
+  for (int i = 0; i < 4; i++) context_add(cxt, cst+i);
+
+  T *dif = ndiff_alloc(lhs, rhs, cxt, 0, 0);
+  ndiff_result(dif, res, 0);
+  ndiff_canon(dif, 1);
+  ndiff_loop(dif);
+
+  llong cnt;
+  ndiff_getInfo(dif, 0, 0, &cnt, 0);
+  ndiff_free(dif);
+  context_free(cxt);
+
+  char buf[128] = "";
+  rewind(res);
+  UTEST(fgets(buf, sizeof buf, res) != 0);
+  UTEST(cnt == 0);
+  UTEST(!strcmp(buf, "x 1e+00 -1.235e-04 7 4.2e+01 1.50e+02 * 4.2e-07\n"));
+
+  fclose(lhs), fclose(rhs), fclose(res);
+}
+
+// goto tag beyond the search limit: both sides restored, failure counted, diff continues
+static void
+ut_testWithin(struct utest *utest, T* dif_)
+{
+  (void)dif_;
+
+  FILE *lhs = tmpfile(), *rhs = tmpfile();
+  ensure(lhs && rhs, "unable to create temporary files");
+
+  fputs("a 1\nb 2\nc 3\nd 4\ntag 5\nf 6\n", lhs);
+  fputs("a 1\nb 2\nc 3\nd 4\ntag 5\nf 7\n", rhs);
+
+  struct constraint cst[] = {
+    constraint_init(slice_initAll(), slice_initAll(), eps_init(eps_abs, 1e-12), -1, 0),
+    constraint_init(slice_init(2), slice_initAll(), eps_initStrTag(eps_goto, "tag"), -1, 0),
+  };
+
+  unsigned level = logmsg_config.level;
+  logmsg_config.level = error_level;
+
+  llong row[2], cnt[2], num[2];
+  for (int i = 0; i < 2; i++) {
+    rewind(lhs), rewind(rhs);
+    struct context *cxt = context_alloc(0);
+    for (int k = 0; k < 2; k++) context_add(cxt, cst+k);
+    T *dif = ndiff_alloc(lhs, rhs, cxt, 0, 0);
+    ndiff_within(dif, i ? 3 : 4); // tag on the 4th line searched
+    ndiff_loop(dif);
+    ndiff_getInfo(dif, row+i, 0, cnt+i, num+i);
+    ndiff_free(dif);
+    context_free(cxt);
+  }
+
+  logmsg_config.level = level;
+
+  UTEST(row[0] == 7 && cnt[0] == 1 && num[0] == 3);
+  UTEST(row[1] == 7 && cnt[1] == 2 && num[1] == 6);
+
+  fclose(lhs), fclose(rhs);
+}
+
+// regions of rows positioned over mixed line ends, the rows after are not read
+static void
+ut_testRows(struct utest *utest, T* dif_)
+{
+  (void)dif_;
+
+  FILE *lhs = tmpfile(), *rhs = tmpfile();
+  ensure(lhs && rhs, "unable to create temporary files");
+
+  fputs("a 1\nb 2\r\nc 3\rd 4\ne 5\nf 6\n", lhs);
+  fputs("a 1\nb 9\r\nc 3\rd 4\ne 9\nf 9\n", rhs);
+
+  struct constraint cst =
+    constraint_init(slice_initAll(), slice_initAll(), eps_init(eps_abs, 1e-12), -1, 0);
+
+  unsigned level = logmsg_config.level;
+  logmsg_config.level = error_level;
+
+  llong first[2] = { 3, 2 }, last[2] = { 5, 2 };
+  llong row[2], cnt[2], num[2];
+  for (int i = 0; i < 2; i++) {
+    rewind(lhs), rewind(rhs);
+    struct context *cxt = context_alloc(0);
+    context_add(cxt, &cst);
+    T *dif = ndiff_alloc(lhs, rhs, cxt, 0, 0);
+    ndiff_rows(dif, first[i], last[i]);
+    ndiff_loop(dif);
+    ndiff_getInfo(dif, row+i, 0, cnt+i, num+i);
+    ndiff_free(dif);
+    context_free(cxt);
+  }
+
+  logmsg_config.level = level;
+
+  UTEST(row[0] == 5 && cnt[0] == 1 && num[0] == 3);
+  UTEST(row[1] == 2 && cnt[1] == 1 && num[1] == 1);
+
+  fclose(lhs), fclose(rhs);
+}
+
+static void
+ut_testIncr(struct utest *utest, T* dif_)
+{
+  (void)dif_;
+
+  FILE *lhs = tmpfile(), *rhs = tmpfile(), *blk = tmpfile();
+  ensure(lhs && rhs && blk, "unable to create temporary files");
+
+  long pos = 0;
+  for (int k = 1; k <= 40; k++) {
+    if (k == 30) pos = ftell(lhs) + 3;
+    fprintf(lhs, "%d 1.5 2.5\n", k);
+    fprintf(rhs, "%d 1.5 2.5\n", k);
+  }
+
+  struct constraint cst =
+    constraint_init(slice_initAll(), slice_initAll(), eps_init(eps_abs, 1e-12), -1, 0);
+
+  unsigned level = logmsg_config.level;
+  logmsg_config.level = error_level;
+
+  // run recording the blocks, rerun after a change in the 4th block of 8 rows, full run
+  llong row[3], cnt[3], num[3], reused = 0;
+  for (int i = 0; i < 3; i++) {
+    if (i == 1) fseek(lhs, pos, SEEK_SET), fputs("2.5", lhs);
+    rewind(lhs), rewind(rhs);
+    struct context *cxt = context_alloc(0);
+    context_add(cxt, &cst);
+    struct incr *inc = i < 2 ? incr_alloc(0) : 0;
+    if (i == 1) rewind(blk), incr_load(inc, blk);
+    T *dif = ndiff_alloc(lhs, rhs, cxt, 0, 0);
+    ndiff_incr(dif, inc, 8);
+    ndiff_loop(dif);
+    ndiff_getInfo(dif, row+i, 0, cnt+i, num+i);
+    if (i == 0) incr_save(inc, blk);
+    if (i == 1) incr_getInfo(inc, 0, &reused);
+    ndiff_free(dif);
+    context_free(cxt);
+    incr_free(inc);
+  }
+
+  logmsg_config.level = level;
+
+  UTEST(row[0] == 41 && cnt[0] == 0 && num[0] == 120);
+  UTEST(row[1] == row[2] && cnt[1] == cnt[2] && num[1] == num[2] && cnt[1] == 1);
+  UTEST(reused == 32);
+
+  fclose(lhs), fclose(rhs), fclose(blk);
+}
+
+// a rule failing in the 2nd block reveals a strict alt rule (onfail) failing in the 5th block,
+// the incremental rerun after a change in the 5th block must reveal it too
+static void
+ut_testIncrAlt(struct utest *utest, T* dif_)
+{
+  (void)dif_;
+
+  FILE *lhs = tmpfile(), *rhs = tmpfile(), *blk = tmpfile();
+  ensure(lhs && rhs && blk, "unable to create temporary files");
+
+  long pos = 0;
+  for (int k = 1; k <= 40; k++) {
+    if (k == 35) pos = ftell(lhs) + 3;
+    fprintf(lhs, "%d 1.5 2.5\n", k);
+    fprintf(rhs, "%d %s 2.5\n", k, k == 10 ? "1.6" : "1.5");
+  }
+
+  // onfail of a rule clears the alt qualifier of the rule before it
+  struct constraint cst[] = {
+    constraint_init(slice_initAll()      , slice_initAll(), eps_init(eps_abs             , 1    ), -1, 0),
+    constraint_init(slice_initLast(20,40), slice_initAll(), eps_init(eps_abs | eps_alt   , 1e-12), -1, 0),
+    constraint_init(slice_initLast( 1,15), slice_initAll(), eps_init(eps_abs | eps_nofail, 1e-12), -1, 0),
+    constraint_init(slice_init(50)       , slice_initAll(), eps_init(eps_abs | eps_alt   , 1e-12), -1, 0),
+  };
+
+  unsigned level = logmsg_config.level;
+  logmsg_config.level = error_level;
+
+  // run recording the blocks, rerun after a change in the 5th block of 8 rows, full run
+  llong row[3], cnt[3], num[3];
+  for (int i = 0; i < 3; i++) {
+    if (i == 1) fseek(lhs, pos, SEEK_SET), fputs("1.6", lhs);
+    rewind(lhs), rewind(rhs);
+    struct context *cxt = context_alloc(0);
+    for (int k = 0; k < 4; k++) context_add(cxt, cst+k);
+    struct incr *inc = i < 2 ? incr_alloc(0) : 0;
+    if (i == 1) rewind(blk), incr_load(inc, blk);
+    T *dif = ndiff_alloc(lhs, rhs, cxt, 0, 0);
+    ndiff_incr(dif, inc, 8);
+    ndiff_loop(dif);
+    ndiff_getInfo(dif, row+i, 0, cnt+i, num+i);
+    if (i == 0) incr_save(inc, blk);
+    ndiff_free(dif);
+    context_free(cxt);
+    incr_free(inc);
+  }
+
+  logmsg_config.level = level;
+
+  UTEST(cnt[0] == 0);
+  UTEST(row[1] == row[2] && cnt[1] == cnt[2] && num[1] == num[2] && cnt[2] == 1);
+
+  fclose(lhs), fclose(rhs), fclose(blk);
+}
+
+// range forms against their scalar counterparts, overlapping ranges and reductions
+static void
+ut_testRange(struct utest *utest, T* dif_)
+{
+  (void)dif_;
+
+  double reg[40] = { 0 };
+  int ok = 1;
+
+  for (int i = 0; i < 7; i++) reg[10+i] = i+1, reg[20+i] = 0.5*i - 1; // R11~R17, R21~R27
+  reg[1] = 3;                                                          // R2
+
+  reg_evalRange(reg, 40, 31, 37, 11, 2, '*', reg_range);               // R31~R37=R11~R17*R2
+  for (int i = 0; i < 7; i++) ok &= reg[30+i] == reg[10+i]*3;
+  UTEST(ok);
+
+  reg_evalRange(reg, 40, 31, 37, 11, 21, '>', reg_ranges);             // R31~R37=R11~R17>R21~R27
+  for (int i = 0; i < 7; i++) ok &= reg[30+i] == (i+1 > 0.5*i-1 ? i+1 : 0.5*i-1);
+  UTEST(ok);
+
+  reg_evalRange(reg, 40, 12, 17, 11, 21, '-', reg_ranges);             // R12~R17=R11~R16-R21~R26
+  for (int i = 0; i < 6; i++) ok &= reg[11+i] == (i+1) - (0.5*i-1);
+  UTEST(ok && reg[10] == 1);
+
+  for (int i = 0; i < 7; i++) reg[10+i] = i+1;                         // R11~R17
+  reg_evalRange(reg, 40, 11, 16, 12, 2, '+', reg_range);               // R11~R16=R12~R17+R2
+  for (int i = 0; i < 6; i++) ok &= reg[10+i] == i+2 + 3;
+  UTEST(ok && reg[16] == 7);
+
+  for (int i = 0; i < 7; i++) reg[10+i] = i+1;                         // R11~R17
+  reg_evalRange(reg, 40, 12, 16, 11, 13, '-', reg_ranges);             // R12~R16=R11~R15-R13~R17
+  for (int i = 0; i < 5; i++) ok &= reg[11+i] == -2;
+  UTEST(ok && reg[10] == 1 && reg[16] == 7);
+
+  reg_evalRange(reg, 40, 1, 0, 31, 37, '+', reg_reduce);               // R1=+R31~R37
+  UTEST(reg[0] == 28);
+  reg_evalRange(reg, 40, 1, 0, 21, 27, '<', reg_reduce);               // R1=<R21~R27
+  UTEST(reg[0] == -1);
+  reg_evalRange(reg, 40, 1, 0, 21, 27, '>', reg_reduce);               // R1=>R21~R27
+  UTEST(reg[0] == 2);
+}
+
 // ----- unit tests
 
 static struct spec {
@@ -1052,6 +2606,14 @@ static struct spec {
 } spec[] = {
   { "power of 10",                          0        , ut_testPow10, 0           },
   { "empty input",                          0        , ut_testNul  , ut_teardown },
+  { "rows past 32-bit limits",              0        , ut_testHuge , 0           },
+  { "sampled rows",                         0        , ut_testSample, 0          },
+  { "canonical filter",                     0        , ut_testCanon, 0           },
+  { "bounded goto search",                  0        , ut_testWithin, 0          },
+  { "region of rows",                       0        , ut_testRows , 0           },
+  { "incremental rediff",                   0        , ut_testIncr , 0           },
+  { "incremental rediff with alt rules",    0        , ut_testIncrAlt, 0         },
+  { "register range operations",            0        , ut_testRange, 0           },
 };
 enum { spec_n = sizeof spec/sizeof *spec };
 
@@ -1076,4 +2638,155 @@ ndiff_utest(struct utest *ut)
   ndiff_free(dif);
 }
 
+// -----------------------------------------------------------------------------
+// ----- microbenchmarks
+// -----------------------------------------------------------------------------
+
+// representative TFS row and numbers
+static const char ub_line[] =
+  " \"E00000042\"   1.2345678901e+00  -6.6919630395e-03   -198.19049871   42"
+  "   0.00061952   MARKER   4.0725577654E+02  -9.87e-12   +3.5";
+
+static char ub_num[8][24] = {
+  "1.2345678901e+00", "-6.6919630395e-03", "-198.19049871", "42",
+  "0.00061952", "4.0725577654E+02", "-9.87e-12", "+3.5"
+};
+
+static volatile double ub_sink;
+
+static void
+ub_parseNumber(void *arg, long n)
+{
+  long s = 0;
+  (void)arg;
+
+  for (long k = 0; k < n; k++)
+    s += parse_number(ub_num[k & 7], 0,0,0,0);
+
+  ub_sink = s;
+}
+
+static void
+ub_strtod(void *arg, long n)
+{
+  double s = 0;
+  (void)arg;
+
+  for (long k = 0; k < n; k++)
+    s += strtod(ub_num[k & 7], 0);
+
+  ub_sink = s;
+}
+
+static void
+ub_isSeparator(void *arg, long n)
+{
+  long s = 0;
+  int  i = 0;
+  (void)arg;
+
+  for (long k = 0; k < n; k++) {
+    s += is_separator(ub_line[i]);
+    if (!ub_line[++i]) i = 0;
+  }
+
+  ub_sink = s;
+}
+
+// one call is nextNum followed by the parse_number of both numbers (as in testNum)
+static void
+ub_nextNum(void *arg, long n)
+{
+  T *dif = arg;
+  struct constraint cst = constraint_init(slice_initAll(), slice_initAll(), eps_init(eps_rel, 1e-10), 0, 0);
+
+  for (long k = 0; k < n; ) {
+    long k0 = k;
+    dif->lhs_i = dif->rhs_i = dif->col_i = 0;
+
+    while (k < n && ndiff_nextNum(dif, &cst)) {
+      dif->lhs_i += parse_number(dif->lhs_b+dif->lhs_i, 0,0,0,0);
+      dif->rhs_i += parse_number(dif->rhs_b+dif->rhs_i, 0,0,0,0);
+      k++;
+    }
+
+    if (k == k0) break;
+  }
+
+  ub_sink = dif->num_i;
+}
+
+static void
+ub_regEval(void *arg, long n)
+{
+  double reg[4] = { 1.0, 1e-9, 0, 0 };
+  (void)arg;
+
+  for (long k = 0; k < n; k++)
+    reg_eval(reg, 4, 3, 1, 2, '+');   // R3=R1+R2
+
+  ub_sink = reg[2];
+}
+
+static void
+ub_regEvalRange(void *arg, long n)
+{
+  double reg[80] = { 1.0, 1e-9 };
+  (void)arg;
+
+  for (long k = 0; k < n; k++)
+    reg_evalRange(reg, 80, 11, 42, 43, 2, '+', reg_range); // R11~R42=R43~R74+R2
+
+  ub_sink = reg[10];
+}
+
+static void
+ub_pow10(void *arg, long n)
+{
+  double s = 0;
+  (void)arg;
+
+  for (long k = 0; k < n; k++)
+    s += pow10((int)(k & 31) - 16);
+
+  ub_sink = s;
+}
+
+static void
+ub_pow(void *arg, long n)
+{
+  double s = 0;
+  (void)arg;
+
+  for (long k = 0; k < n; k++)
+    s += pow(10, (int)(k & 31) - 16);
+
+  ub_sink = s;
+}
+
+void
+ndiff_bench(struct utest *ut)
+{
+  assert(ut);
+  T *dif = ndiff_alloc(stdout, stdout, 0, 0, 0);
+
+  ensure(dif->buf_n > (int)sizeof ub_line, "buffer too small for benchmarks");
+  strcpy(dif->lhs_b, ub_line);
+  strcpy(dif->rhs_b, ub_line);
+
+  utest_title(ut, "File diff");
+
+  // no replacement of strtod exists yet, it is timed standalone for reference
+  utest_bench(ut, "ndiff.parse_number"  , ub_parseNumber, 0);
+  utest_bench(ut, "ndiff.strtod"        , ub_strtod     , 0);
+  utest_bench(ut, "ndiff.is_separator"  , ub_isSeparator, 0);
+  utest_bench(ut, "ndiff.nextNum"       , ub_nextNum    , dif);
+  utest_bench(ut, "register.reg_eval"   , ub_regEval    , 0);
+  utest_bench(ut, "register.reg_evalRange", ub_regEvalRange, 0);
+  utest_bench(ut, "utils.pow10"         , ub_pow10      , 0);
+  utest_bench(ut, "libm.pow"            , ub_pow        , 0);
+
+  ndiff_free(dif);
+}
+
 #endif
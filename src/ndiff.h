@@ -25,6 +25,11 @@
 
 struct utest;
 struct ndiff;
+struct stats;
+struct flight;
+struct report;
+struct errstats;
+struct incr;
 struct context;
 struct constraint;
 
@@ -41,9 +46,22 @@ enum ndiff_options {
 
 T*    ndiff_alloc    (FILE *lhs, FILE *rhs, struct context*, int n_, int r_);
 void  ndiff_clear    (T*);
+void  ndiff_reset    (T*, FILE *lhs, FILE *rhs); // restart, keep buffers and options
 void  ndiff_free     (T*);
 void  ndiff_option   (T*, const int *keep_, const int *blank_, const int *check_, const int *recycle_);
 void  ndiff_result   (T*, FILE *lhs, FILE *rhs);
+void  ndiff_canon    (T*, int canon); // rewrite numbers of result lines by rule
+void  ndiff_stats    (T*, struct stats*);
+void  ndiff_flight   (T*, struct flight*);
+void  ndiff_report   (T*, struct report*);
+void  ndiff_errstats (T*, struct errstats*);
+void  ndiff_window   (T*, int win); // 0: unbounded
+void  ndiff_sample   (T*, double rate, ullong seed); // rate in ]0,1]
+void  ndiff_within   (T*, llong max); // goto search limit (lines), 0: unbounded
+void  ndiff_async    (T*, llong lines); // goto lines before the concurrent search, 0: never
+void  ndiff_incr     (T*, struct incr*, llong rows); // rows per block, 0: default
+void  ndiff_rows     (T*, llong first, llong last); // region of rows, last 0: unbounded
+void  ndiff_cols     (T*, llong first, llong last); // region of number columns, last 0: unbounded
 
 // high level API
 void  ndiff_loop     (T*);
@@ -51,16 +69,18 @@ void  ndiff_loop     (T*);
 // low level API
 int   ndiff_outLine  (T*);
 int   ndiff_skipLine (T*);
+int   ndiff_skipLines(T*, llong n); // stop at end of file
 int   ndiff_readLine (T*);
 int   ndiff_fillLine (T*, const char *lhs, const char *rhs);
 
 int   ndiff_gotoLine (T*, const C*);
 int   ndiff_gotoNum  (T*, const C*);
 
-int   ndiff_nextNum  (T*, const C*); // return 0 if no number is found
+llong ndiff_nextNum  (T*, const C*); // return 0 if no number is found
 int   ndiff_testNum  (T*, const C*);
 
-void  ndiff_getInfo  (const T*, int *row_, int *col_, int *cnt_, long *num_);
+void  ndiff_getInfo  (const T*, llong *row_, llong *col_, llong *cnt_, llong *num_);
+void  ndiff_getSample(const T*, llong *rows_, llong *skip_);
 int   ndiff_feof     (const T*, int both);
 int   ndiff_isempty  (const T*);
 
@@ -72,6 +92,7 @@ int   ndiff_isempty  (const T*);
 #ifndef NTEST
 
 void ndiff_utest (struct utest*);
+void ndiff_bench (struct utest*);
 
 #endif // NTEST
 #endif
@@ -0,0 +1,217 @@
+/*
+ o---------------------------------------------------------------------o
+ |
+ | Ndiff
+ |
+ | Copyright (c) 2012+ laurent.deniau@cern.ch
+ | Gnu General Public License
+ |
+ o---------------------------------------------------------------------o
+
+   Purpose:
+     read hardware performance counters (Linux perf_event_open)
+     degrade silently to no counters elsewhere
+
+ o---------------------------------------------------------------------o
+*/
+
+#define _DEFAULT_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#include "error.h"
+#include "perf.h"
+
+#define T struct perf
+
+// ----- types
+
+struct perf {
+  int   fd [perf_event_n];
+  void *pg [perf_event_n]; // mmap page for user space rdpmc
+  int   pos[perf_event_n]; // position in the group read
+  int   ldr, nr;           // group leader event, events in the group
+  int   mask;
+};
+
+// ----- private
+
+static const char *event_str[perf_event_n] = {
+  "cycles", "instructions", "L1d-misses", "LLC-misses", "branch-misses"
+};
+
+#ifdef __linux__
+
+static const struct {
+  uint type;
+  ullong config;
+} event_cfg[perf_event_n] = {
+  { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES       },
+  { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS     },
+  { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D |
+                       (PERF_COUNT_HW_CACHE_OP_READ     <<  8) |
+                       (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+  { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES     },
+  { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES    },
+};
+
+// events are scheduled together as one group (same share of multiplexing)
+static int
+event_open (int i, int group)
+{
+  struct perf_event_attr pe;
+
+  memset(&pe, 0, sizeof pe);
+  pe.size   = sizeof pe;
+  pe.type   = event_cfg[i].type;
+  pe.config = event_cfg[i].config;
+  pe.exclude_kernel = 1; // allowed up to perf_event_paranoid == 2
+  pe.exclude_hv     = 1;
+  pe.read_format    = PERF_FORMAT_GROUP |
+                      PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+  return syscall(__NR_perf_event_open, &pe, 0, -1, group, 0);
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PERF_RDPMC 1
+
+static inline ullong
+rdpmc (uint c)
+{
+  uint lo, hi;
+  __asm__ volatile("rdpmc" : "=a"(lo), "=d"(hi) : "c"(c));
+  return lo | (ullong)hi << 32;
+}
+
+// read the counter from user space, return 0 if not possible right now
+// or if the counter was multiplexed (count to scale)
+static inline int
+event_rdpmc (const struct perf_event_mmap_page *pg, ullong *val)
+{
+  uint seq, idx;
+  long long cnt;
+
+  do {
+    seq = pg->lock;
+    __asm__ volatile("" ::: "memory");
+    idx = pg->index;
+    cnt = pg->offset;
+    if (!pg->cap_user_rdpmc || !idx || pg->time_enabled != pg->time_running) return 0;
+    long long pmc = rdpmc(idx-1);
+    int shift = 64 - pg->pmc_width;
+    cnt += (pmc << shift) >> shift;
+    __asm__ volatile("" ::: "memory");
+  } while (pg->lock != seq);
+
+  *val = cnt;
+  return 1;
+}
+#endif
+
+#endif // __linux__
+
+// -----------------------------------------------------------------------------
+// ----- interface
+// -----------------------------------------------------------------------------
+
+T*
+perf_alloc (void)
+{
+#ifdef __linux__
+  T *p = malloc(sizeof *p);
+  ensure(p, "out of memory");
+  *p = (T) { .ldr = -1 };
+
+  for (int i = 0; i < perf_event_n; i++) {
+    p->fd[i] = event_open(i, p->ldr < 0 ? -1 : p->fd[p->ldr]);
+    p->pg[i] = 0;
+    if (p->fd[i] < 0) {
+      debug("perf counter '%s' unavailable", event_str[i]);
+      continue;
+    }
+    if (p->ldr < 0) p->ldr = i;
+    p->pos[i] = p->nr++;
+    p->mask |= 1 << i;
+
+#ifdef PERF_RDPMC
+    void *pg = mmap(0, sysconf(_SC_PAGESIZE), PROT_READ, MAP_SHARED, p->fd[i], 0);
+    if (pg != MAP_FAILED) p->pg[i] = pg;
+#endif
+  }
+
+  if (!p->mask) {
+    free(p);
+    return 0;
+  }
+
+  return p;
+#else
+  return 0;
+#endif
+}
+
+void
+perf_free (T *p)
+{
+#ifdef __linux__
+  if (!p) return;
+
+  for (int i = 0; i < perf_event_n; i++) {
+    if (p->pg[i]) munmap(p->pg[i], sysconf(_SC_PAGESIZE));
+    if (p->fd[i] >= 0) close(p->fd[i]);
+  }
+#endif
+  free(p);
+}
+
+int
+perf_read (T *p, ullong val[perf_event_n])
+{
+  assert(p && val);
+
+  int mask = 0;
+
+#ifdef __linux__
+  for (int i = 0; i < perf_event_n; i++) {
+    val[i] = 0;
+#ifdef PERF_RDPMC
+    if (p->pg[i] && event_rdpmc(p->pg[i], val+i)) mask |= 1 << i;
+#endif
+  }
+  if (mask == p->mask) return mask;
+
+  // group read: nr, time enabled, time running, values in group order
+  ullong buf[3+perf_event_n];
+  ssize_t n = read(p->fd[p->ldr], buf, sizeof buf);
+  if (n != (ssize_t)((3+p->nr) * sizeof *buf) || !buf[2]) return mask; // unavailable
+
+  // scale the counts of multiplexed counters by the running share
+  double scl = buf[1] > buf[2] ? (double)buf[1] / buf[2] : 1;
+
+  for (int i = 0; i < perf_event_n; i++)
+    if (p->mask & ~mask & (1 << i)) {
+      val[i] = (ullong)(buf[3+p->pos[i]] * scl);
+      mask |= 1 << i;
+    }
+#endif
+
+  return mask;
+}
+
+const char*
+perf_name (enum perf_event e)
+{
+  return e < perf_event_n ? event_str[e] : "";
+}
+
+#undef T
@@ -0,0 +1,49 @@
+#ifndef PERF_H
+#define PERF_H
+
+/*
+ o---------------------------------------------------------------------o
+ |
+ | Ndiff
+ |
+ | Copyright (c) 2012+ laurent.deniau@cern.ch
+ | Gnu General Public License
+ |
+ o---------------------------------------------------------------------o
+
+   Purpose:
+     read hardware performance counters (Linux perf_event_open)
+     degrade silently to no counters elsewhere
+
+ o---------------------------------------------------------------------o
+*/
+
+#include "types.h"
+
+// ----- constants
+
+enum perf_event {
+  perf_cycles, perf_instrs, perf_l1miss, perf_llcmiss, perf_brmiss,
+
+  perf_event_n
+};
+
+// ----- types
+
+struct perf;
+
+// ----- interface
+
+#define T struct perf
+
+T*          perf_alloc (void); // return 0 if no counter can be opened
+void        perf_free  (T*);
+
+// read counters (user space only, scaled if multiplexed), return the mask of
+// valid events, the values of unavailable events must not be used
+int         perf_read  (T*, ullong val[perf_event_n]);
+const char* perf_name  (enum perf_event);
+
+#undef T
+
+#endif
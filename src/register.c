@@ -11,16 +11,121 @@
    Purpose:
      manage access to registers
      handle arithmetic operations (+, -, *, /) and range (~)
+     handle element-wise operations and reductions over ranges
  
  o---------------------------------------------------------------------o
 */
 
 #include <math.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "args.h"
 #include "register.h"
 
+// ----- private (range operations)
+
+// element-wise loops over contiguous registers, kept simple to be vectorized by the compiler,
+// backward when a source starts before the destination (overlapping registers, as '~')
+#define REG_LOOP(expr) \
+  if (!back) for (short i=0; i < n; i++) d[i] = (expr); \
+  else       for (short i=n-1; i >= 0; i--) d[i] = (expr)
+
+static void
+reg_rangeScl(double *d, const double *a, double b, short n, char op, bool back)
+{
+  switch(op) {
+  case '+': REG_LOOP(a[i] + b); break;
+  case '-': REG_LOOP(a[i] - b); break;
+  case '*': REG_LOOP(a[i] * b); break;
+  case '/': REG_LOOP(a[i] / b); break;
+  case '%': REG_LOOP(fmod(a[i], b)); break;
+  case '^': REG_LOOP(pow(a[i], b)); break;
+  case '<': REG_LOOP(a[i] < b ? a[i] : b); break;
+  case '>': REG_LOOP(a[i] > b ? a[i] : b); break;
+  default:
+    error("invalid register range operation '%c'", op);
+  }
+}
+
+static void
+reg_rangeRng(double *d, const double *a, const double *b, short n, char op, bool back)
+{
+  switch(op) {
+  case '+': REG_LOOP(a[i] + b[i]); break;
+  case '-': REG_LOOP(a[i] - b[i]); break;
+  case '*': REG_LOOP(a[i] * b[i]); break;
+  case '/': REG_LOOP(a[i] / b[i]); break;
+  case '%': REG_LOOP(fmod(a[i], b[i])); break;
+  case '^': REG_LOOP(pow(a[i], b[i])); break;
+  case '<': REG_LOOP(a[i] < b[i] ? a[i] : b[i]); break;
+  case '>': REG_LOOP(a[i] > b[i] ? a[i] : b[i]); break;
+  default:
+    error("invalid register range operation '%c'", op);
+  }
+}
+
+#undef REG_LOOP
+
+// four independent lanes, a single accumulator would serialize the reduction
+#define REG_REDUCE(init, expr) \
+  { double r[4] = { init, init, init, init }; short i=0; \
+    for (; i+4 <= n; i+=4) \
+      for (short k=0; k < 4; k++) r[k] = (expr(r[k], a[i+k])); \
+    for (; i < n; i++) r[0] = (expr(r[0], a[i])); \
+    return expr(expr(r[0], r[1]), expr(r[2], r[3])); }
+
+#define REG_ADD(x,y) ((x) + (y))
+#define REG_MUL(x,y) ((x) * (y))
+#define REG_LT(x,y)  ((x) < (y) ? (x) : (y))
+#define REG_GT(x,y)  ((x) > (y) ? (x) : (y))
+
+static double
+reg_rangeRed(const double *a, short n, char op)
+{
+  switch(op) {
+  case '+': REG_REDUCE(0   , REG_ADD);
+  case '*': REG_REDUCE(1   , REG_MUL);
+  case '<': REG_REDUCE(a[0], REG_LT );
+  case '>': REG_REDUCE(a[0], REG_GT );
+  default:
+    error("invalid register reduction '%c'", op); return 0;
+  }
+}
+
+#undef REG_REDUCE
+#undef REG_ADD
+#undef REG_MUL
+#undef REG_LT
+#undef REG_GT
+
+// source range overlapping the destination from before (backward) or after (forward)
+static inline bool
+reg_before(const double *s, const double *d, short n)
+{
+  return s < d && d < s+n;
+}
+
+static inline bool
+reg_after(const double *s, const double *d, short n)
+{
+  return d < s && s < d+n;
+}
+
+// sources overlapping the destination from both sides, copy the one after first
+// (rare, kept out of line with its buffer)
+#ifdef __GNUC__
+__attribute__((noinline))
+#endif
+static void
+reg_rangeMix(double *d, const double *a, const double *b, short n, char op)
+{
+  double tmp[REG_MAX];
+  if (reg_after(a, d, n)) a = memcpy(tmp, a, n * sizeof *a);
+  else                    b = memcpy(tmp, b, n * sizeof *b);
+  reg_rangeRng(d, a, b, n, op, true);
+}
+
 // ----- interface
 
 double
@@ -38,7 +143,7 @@ reg_getval(const double *reg, short reg_n, short rn)
   case 5: return fabs(reg[r-1]);
   case 6: return floor(reg[r-1]);
   case 7: return ceil(reg[r-1]);
-  default: error("invalid register unary operation '%c'", rn/REG_MAX); exit(EXIT_FAILURE);
+  default: error("invalid register unary operation '%c'", rn/REG_MAX); return 0;
   }
 }
 
@@ -128,3 +233,46 @@ reg_eval(double *reg, short reg_n, short dst, short src, short src2, char op)
     reg_eval_print (reg, reg_n,      src, src2, op);
 }
 
+
+void
+reg_evalRange(double *reg, short reg_n, short dst, short dst2, short src, short src2, char op, char form)
+{
+  if (form == reg_reduce) {
+    ensure(dst >= 0 && dst <= reg_n, "invalid register %d", dst);
+    ensure(src > 0 && src < src2 && src2 <= reg_n, "invalid range of registers R%d~R%d", src, src2);
+
+    double val = reg_rangeRed(reg+src-1, src2-src+1, op);
+
+    if (dst)
+      reg[dst-1] = val;
+    else
+      printf(option.rfmt, val), putchar('\n');
+    return;
+  }
+
+  short n = dst2-dst+1;
+  ensure(dst > 0 && dst < dst2 && dst2 <= reg_n, "invalid range of registers R%d~R%d", dst, dst2);
+  ensure(src > 0 && src+n-1 <= reg_n, "invalid range of registers R%d~R%d", src, src+n-1);
+
+  double *d = reg+dst-1;
+  const double *a = reg+src-1;
+
+  if (form == reg_ranges) {
+    ensure(src2 > 0 && src2+n-1 <= reg_n, "invalid range of registers R%d~R%d", src2, src2+n-1);
+
+    const double *b = reg+src2-1;
+    bool back = reg_before(a, d, n) || reg_before(b, d, n);
+
+    if (back && (reg_after(a, d, n) || reg_after(b, d, n)))
+      reg_rangeMix(d, a, b, n, op);
+    else
+      reg_rangeRng(d, a, b, n, op, back);
+  }
+  else {
+    ensure(form == reg_range, "invalid register operation form %d", form);
+    ensure(src2 > 0 && src2 <= reg_n, "invalid register R%d", src2);
+
+    // the scalar is read once, before the loop
+    reg_rangeScl(d, a, reg[src2-1], n, op, reg_before(a, d, n));
+  }
+}
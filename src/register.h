@@ -14,6 +14,7 @@
    Purpose:
      manage access to registers
      handle arithmetic operations (+, -, *, /) and range (~)
+     handle element-wise operations and reductions over ranges
  
  o---------------------------------------------------------------------o
 */
@@ -27,6 +28,11 @@
 #define REG_MAX (1 << 13)
 #define REG_UNARY_OP  "-/\\^|[]"
 #define REG_BINARY_OP "+-*/%^<>~"
+#define REG_RANGE_OP  "+-*/%^<>"
+#define REG_REDUCE_OP "+*<>"
+
+// forms of operations: Rn=Rp op Rq, Rn~Rm=Rp~.. op Rq, Rn~Rm=Rp~.. op Rq~.., Rn=op Rp~Rq
+enum { reg_scalar, reg_range, reg_ranges, reg_reduce };
 
 // ----- attributes
 
@@ -57,7 +63,7 @@ reg_encode(short rn, char op)
   case '|' : return 5 * REG_MAX + rn;
   case '[' : return 6 * REG_MAX + rn;
   case ']' : return 7 * REG_MAX + rn;
-  default: error("invalid register unary operation '%c'", op); exit(EXIT_FAILURE);
+  default: error("invalid register unary operation '%c'", op); return 0;
   }
 }
 
@@ -89,6 +95,7 @@ reg_setval(double *reg, short reg_n, short rn, double val)
 
 double reg_getval(const double *reg, short reg_n, short rn);
 void   reg_eval  (double       *reg, short reg_n, short dst, short src, short src2, char op);
+void   reg_evalRange(double    *reg, short reg_n, short dst, short dst2, short src, short src2, char op, char form);
 
 #endif
 
@@ -0,0 +1,352 @@
+/*
+ o---------------------------------------------------------------------o
+ |
+ | Ndiff
+ |
+ | Copyright (c) 2012+ laurent.deniau@cern.ch
+ | Gnu General Public License
+ |
+ o---------------------------------------------------------------------o
+
+   Purpose:
+     collect diff records into a large buffer
+     write them to a file as text, JSON Lines or binary records
+
+ o---------------------------------------------------------------------o
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <assert.h>
+
+#include "error.h"
+#include "report.h"
+#include "constraint.h"
+
+#define T struct report
+
+// ----- constants
+
+// size of the output buffer
+#ifndef REPORTBUFSIZ
+#define REPORTBUFSIZ (1 << 20)
+#endif
+
+// ----- types
+
+struct report {
+  FILE  *fp;
+  int    fmt;
+
+  // pending pair of files
+  char   lhs[FILENAME_MAX], rhs[FILENAME_MAX], test[FILENAME_MAX];
+  bool   pending;
+
+  // output buffer
+  char  *buf;
+  size_t buf_i, buf_n;
+};
+
+// ----- private (buffer)
+
+static void
+report_write (T *rep)
+{
+  if (rep->buf_i && fwrite(rep->buf, 1, rep->buf_i, rep->fp) != rep->buf_i)
+    error("unable to write report");
+  rep->buf_i = 0;
+}
+
+static void
+report_reserve (T *rep, size_t n)
+{
+  if (rep->buf_i + n <= rep->buf_n) return;
+
+  report_write(rep);
+
+  if (n > rep->buf_n) {
+    rep->buf = realloc(rep->buf, n);
+    ensure(rep->buf, "out of memory");
+    rep->buf_n = n;
+  }
+}
+
+static void
+report_put (T *rep, const void *ptr, size_t n)
+{
+  report_reserve(rep, n);
+  memcpy(rep->buf+rep->buf_i, ptr, n);
+  rep->buf_i += n;
+}
+
+static void
+report_printf (T *rep, const char *fmt, ...)
+{
+  va_list ap;
+
+  for (int k = 0; k < 2; k++) {
+    size_t rem = rep->buf_n - rep->buf_i;
+
+    va_start(ap, fmt);
+    int n = vsnprintf(rep->buf+rep->buf_i, rem, fmt, ap);
+    va_end(ap);
+
+    ensure(n >= 0, "invalid report format");
+    if ((size_t)n < rem) { rep->buf_i += n; return; }
+
+    report_reserve(rep, n+1);
+  }
+
+  error("unable to format report record");
+}
+
+// ----- private (json)
+
+static void
+report_jstr (T *rep, const char *str, int n)
+{
+  report_reserve(rep, 6*n+2);
+
+  char *p = rep->buf+rep->buf_i;
+  *p++ = '"';
+
+  for (int i = 0; i < n; i++) {
+    unsigned char c = str[i];
+    if (c == '"' || c == '\\') *p++ = '\\', *p++ = c;
+    else if (c >= 0x20)        *p++ = c;
+    else p += sprintf(p, "\\u%04x", c);
+  }
+
+  *p++ = '"';
+  rep->buf_i = p - rep->buf;
+}
+
+static void
+report_jfail (T *rep, uint fail)
+{
+  const char *sep = "";
+
+  report_printf(rep, ",\"fail\":[");
+  if (fail & eps_ign) report_printf(rep, "%s\"ign\"", sep), sep = ",";
+  if (fail & eps_equ) report_printf(rep, "%s\"equ\"", sep), sep = ",";
+  if (fail & eps_abs) report_printf(rep, "%s\"abs\"", sep), sep = ",";
+  if (fail & eps_rel) report_printf(rep, "%s\"rel\"", sep), sep = ",";
+  if (fail & eps_dig) report_printf(rep, "%s\"dig\"", sep), sep = ",";
+  report_printf(rep, "]");
+}
+
+// ----- private (binary)
+
+static void
+report_record (T *rep, int kind, const struct report_rec *r)
+{
+  int32_t hdr[2] = { 0, kind };
+  int64_t pos[5] = { r->cnt, r->row, r->col, r->lhs_i, r->rhs_i };
+  int32_t inf[6] = { r->lhs_n, r->rhs_n, r->fail, r->rule, r->line, r->ndig };
+  double val[8] = {
+    r->abs_d, r->rel_d, r->abs[0], r->abs[1], r->rel[0], r->rel[1], r->dig[0], r->dig[1]
+  };
+
+  hdr[0] = sizeof hdr + sizeof pos + sizeof inf + sizeof val + r->lhs_n + r->rhs_n;
+
+  report_put(rep, hdr, sizeof hdr);
+  report_put(rep, pos, sizeof pos);
+  report_put(rep, inf, sizeof inf);
+  report_put(rep, val, sizeof val);
+  report_put(rep, r->lhs_p, r->lhs_n);
+  report_put(rep, r->rhs_p, r->rhs_n);
+}
+
+// ----- private (files)
+
+static void
+report_header (T *rep)
+{
+  rep->pending = false;
+
+  switch (rep->fmt) {
+  case report_text:
+    if (*rep->test)
+      report_printf(rep, "(*) files '%s'|'%s' from '%s' differ\n", rep->lhs, rep->rhs, rep->test);
+    else
+      report_printf(rep, "(*) files '%s'|'%s' differ\n", rep->lhs, rep->rhs);
+    break;
+
+  case report_json:
+    report_printf(rep, "{\"type\":\"files\",\"lhs\":");
+    report_jstr  (rep, rep->lhs, strlen(rep->lhs));
+    report_printf(rep, ",\"rhs\":");
+    report_jstr  (rep, rep->rhs, strlen(rep->rhs));
+    if (*rep->test) {
+      report_printf(rep, ",\"test\":");
+      report_jstr  (rep, rep->test, strlen(rep->test));
+    }
+    report_printf(rep, "}\n");
+    break;
+
+  case report_bin: {
+    struct report_rec r = {
+      .lhs_p = rep->lhs, .lhs_n = strlen(rep->lhs),
+      .rhs_p = rep->rhs, .rhs_n = strlen(rep->rhs)
+    };
+    report_record(rep, report_rec_files, &r);
+  } break;
+  }
+}
+
+// -----------------------------------------------------------------------------
+// ----- interface
+// -----------------------------------------------------------------------------
+
+T*
+report_alloc (const char *filename, enum report_fmt fmt)
+{
+  assert(filename);
+
+  T *rep = malloc(sizeof *rep);
+  ensure(rep, "out of memory");
+
+  rep->fp = fopen(filename, fmt == report_bin ? "wb" : "w");
+  ensure(rep->fp, "unable to open report file '%s'", filename);
+
+  rep->fmt   = fmt;
+  rep->buf_n = REPORTBUFSIZ;
+  rep->buf_i = 0;
+  rep->buf   = malloc(rep->buf_n);
+  ensure(rep->buf, "out of memory");
+
+  rep->pending = false;
+  *rep->lhs = *rep->rhs = *rep->test = 0;
+
+  if (fmt == report_bin) {
+    int32_t ver = report_version;
+    report_put(rep, "NDRP", 4);
+    report_put(rep, &ver, sizeof ver);
+  }
+
+  return rep;
+}
+
+void
+report_free (T *rep)
+{
+  if (!rep) return;
+
+  report_write(rep);
+  fclose(rep->fp);
+  free(rep->buf);
+  free(rep);
+}
+
+void
+report_flush (T *rep)
+{
+  assert(rep);
+  report_write(rep);
+  fflush(rep->fp);
+}
+
+void
+report_files (T *rep, const char *lhs, const char *rhs, const char *test)
+{
+  assert(rep && lhs && rhs);
+
+  snprintf(rep->lhs , sizeof rep->lhs , "%s", lhs);
+  snprintf(rep->rhs , sizeof rep->rhs , "%s", rhs);
+  snprintf(rep->test, sizeof rep->test, "%s", test ? test : "");
+  rep->pending = true;
+}
+
+void
+report_num (T *rep, const struct report_rec *r)
+{
+  assert(rep && r);
+
+  if (rep->pending) report_header(rep);
+
+  switch (rep->fmt) {
+  case report_text:
+    report_printf(rep, "(%lld) files differ at line %lld column %lld between char-columns %lld|%lld and %lld|%lld\n",
+                  r->cnt, r->row, r->col, r->lhs_i+1, r->rhs_i+1, r->lhs_i+1+r->lhs_n, r->rhs_i+1+r->rhs_n);
+    report_printf(rep, "(%lld) numbers: '%.*s'|'%.*s'\n", r->cnt, r->lhs_n, r->lhs_p, r->rhs_n, r->rhs_p);
+
+    if (r->fail & eps_ign)
+      report_printf(rep, "(%lld) one number is missing (column count can be wrong)\n", r->cnt);
+
+    if (r->fail & eps_equ)
+      report_printf(rep, "(%lld) numbers strict representation differ (rule #%d, line %d)\n",
+                    r->cnt, r->rule, r->line);
+
+    if (r->fail & eps_abs)
+      report_printf(rep, "(%lld) absolute error (rule #%d, line %d: %.2g<=abs<=%.2g) abs=%.2g, rel=%.2g, ndig=%d\n",
+                    r->cnt, r->rule, r->line, r->abs[0], r->abs[1], r->abs_d, r->rel_d, r->ndig);
+
+    if (r->fail & eps_rel)
+      report_printf(rep, "(%lld) relative error (rule #%d, line %d: %.2g<=rel<=%.2g) abs=%.2g, rel=%.2g, ndig=%d\n",
+                    r->cnt, r->rule, r->line, r->rel[0], r->rel[1], r->abs_d, r->rel_d, r->ndig);
+
+    if (r->fail & eps_dig)
+      report_printf(rep, "(%lld) numdigit error (rule #%d, line %d: %.2g<=rel<=%.2g) abs=%.2g, rel=%.2g, ndig=%d\n",
+                    r->cnt, r->rule, r->line, r->dig[0], r->dig[1], r->abs_d, r->rel_d, r->ndig);
+    break;
+
+  case report_json:
+    report_printf(rep, "{\"type\":\"num\",\"cnt\":%lld,\"row\":%lld,\"col\":%lld,\"lhs_col\":%lld,\"rhs_col\":%lld,\"lhs\":",
+                  r->cnt, r->row, r->col, r->lhs_i+1, r->rhs_i+1);
+    report_jstr  (rep, r->lhs_p, r->lhs_n);
+    report_printf(rep, ",\"rhs\":");
+    report_jstr  (rep, r->rhs_p, r->rhs_n);
+    report_jfail (rep, r->fail);
+    report_printf(rep, ",\"rule\":%d,\"line\":%d,\"abs\":%.17g,\"rel\":%.17g,\"ndig\":%d"
+                       ",\"abs_lim\":[%.17g,%.17g],\"rel_lim\":[%.17g,%.17g],\"dig_lim\":[%.17g,%.17g]}\n",
+                  r->rule, r->line, r->abs_d, r->rel_d, r->ndig,
+                  r->abs[0], r->abs[1], r->rel[0], r->rel[1], r->dig[0], r->dig[1]);
+    break;
+
+  case report_bin:
+    report_record(rep, report_rec_num, r);
+    break;
+  }
+}
+
+void
+report_str (T *rep, const struct report_rec *r)
+{
+  assert(rep && r);
+
+  if (rep->pending) report_header(rep);
+
+  switch (rep->fmt) {
+  case report_text:
+    report_printf(rep, "(%lld) files differ at line %lld and char-columns %lld|%lld\n",
+                  r->cnt, r->row, r->lhs_i, r->rhs_i);
+    report_printf(rep, "(%lld) strings: '%.*s'|'%.*s'\n", r->cnt, r->lhs_n, r->lhs_p, r->rhs_n, r->rhs_p);
+    break;
+
+  case report_json:
+    report_printf(rep, "{\"type\":\"str\",\"cnt\":%lld,\"row\":%lld,\"lhs_col\":%lld,\"rhs_col\":%lld,\"lhs\":",
+                  r->cnt, r->row, r->lhs_i, r->rhs_i);
+    report_jstr  (rep, r->lhs_p, r->lhs_n);
+    report_printf(rep, ",\"rhs\":");
+    report_jstr  (rep, r->rhs_p, r->rhs_n);
+    report_printf(rep, ",\"rule\":%d,\"line\":%d}\n", r->rule, r->line);
+    break;
+
+  case report_bin:
+    report_record(rep, report_rec_str, r);
+    break;
+  }
+}
+
+int
+report_format (const char *str)
+{
+  if (!strcmp(str, "text")) return report_text;
+  if (!strcmp(str, "json")) return report_json;
+  if (!strcmp(str, "bin" )) return report_bin;
+  return -1;
+}
+
+#undef T
@@ -0,0 +1,75 @@
+#ifndef REPORT_H
+#define REPORT_H
+
+/*
+ o---------------------------------------------------------------------o
+ |
+ | Ndiff
+ |
+ | Copyright (c) 2012+ laurent.deniau@cern.ch
+ | Gnu General Public License
+ |
+ o---------------------------------------------------------------------o
+
+   Purpose:
+     collect diff records into a large buffer
+     write them to a file as text, JSON Lines or binary records
+
+   Binary format (native endianness, no padding):
+     file header : "NDRP" int32 version
+     record      : int32 size (of the whole record), int32 kind,
+                   int64 cnt, row, col, lhs_i, rhs_i,
+                   int32 lhs_n, rhs_n, fail, rule, line, ndig,
+                   double abs_d, rel_d, abs[2], rel[2], dig[2],
+                   lhs_n bytes of lhs text, rhs_n bytes of rhs text
+     files record: kind=report_rec_files, lhs|rhs texts hold the filenames
+
+ o---------------------------------------------------------------------o
+*/
+
+#include <stdio.h>
+#include "types.h"
+
+// ----- constants
+
+enum report_fmt  { report_text, report_json, report_bin };
+enum report_kind { report_rec_files, report_rec_num, report_rec_str };
+
+enum { report_version = 2 }; // 2: 64-bit counters and positions
+
+// ----- types
+
+struct report;
+
+struct report_rec {
+  llong       cnt, row, col;   // diff count, line, column
+  llong       lhs_i, rhs_i;    // char-columns (0-based)
+  int         lhs_n, rhs_n;    // tokens length
+  const char *lhs_p, *rhs_p;   // tokens (not null terminated)
+  uint        fail;            // failed checks (eps_ign, eps_equ, eps_abs, eps_rel, eps_dig)
+  int         rule, line;      // rule index and line in config file
+  int         ndig;
+  double      abs_d, rel_d;    // errors
+  double      abs[2], rel[2], dig[2]; // lower and upper bounds
+};
+
+// ----- interface
+
+#define T struct report
+
+T*   report_alloc (const char *filename, enum report_fmt);
+void report_free  (T*);
+void report_flush (T*);
+
+// start a new pair of files (written before its first record)
+void report_files (T*, const char *lhs, const char *rhs, const char *test);
+
+void report_num   (T*, const struct report_rec*);
+void report_str   (T*, const struct report_rec*);
+
+// parse format name, return -1 if invalid
+int  report_format(const char *str);
+
+#undef T
+
+#endif
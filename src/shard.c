@@ -0,0 +1,163 @@
+/*
+ o---------------------------------------------------------------------o
+ |
+ | Ndiff
+ |
+ | Copyright (c) 2012+ laurent.deniau@cern.ch
+ | Gnu General Public License
+ |
+ o---------------------------------------------------------------------o
+
+   Purpose:
+     assign the pairs of files to shards deterministically
+     balance the shards by file size or by the diff times of a frozen history
+
+ o---------------------------------------------------------------------o
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "error.h"
+#include "utils.h"
+#include "shard.h"
+
+#define T struct shard
+
+// ----- constants
+
+// assumed throughput (bytes/s) to estimate the diff time of pairs without history
+static const double shard_rate = 32e6;
+
+// ----- types
+
+struct hist {
+  char  *name;
+  double time;            // diff time per file of the last run
+  long   idx;
+};
+
+struct shard {
+  int     idx, cnt;
+  double *load;           // estimated diff time per shard
+
+  struct hist *hist;      // sorted by name, last run only
+  long    hist_n, hist_max;
+};
+
+// ----- private
+
+static int
+shard_cmp (const void *a_, const void *b_)
+{
+  const struct hist *a = a_, *b = b_;
+  int c = strcmp(a->name, b->name);
+  return c ? c : (a->idx > b->idx) - (a->idx < b->idx);
+}
+
+static void
+shard_addHist (void *s_, const char *name, double ndtime, int total)
+{
+  T *s = s_;
+
+  if (s->hist_n == s->hist_max) {
+    s->hist_max = s->hist_max ? 2*s->hist_max : 64;
+    s->hist = realloc(s->hist, s->hist_max * sizeof *s->hist);
+    ensure(s->hist, "out of memory");
+  }
+
+  struct hist *h = &s->hist[s->hist_n];
+  h->name = malloc(strlen(name)+1);
+  ensure(h->name, "out of memory");
+  strcpy(h->name, name);
+  h->time = total > 0 ? ndtime / total : ndtime;
+  h->idx  = s->hist_n++;
+}
+
+static const struct hist*
+shard_getHist (const T *s, const char *name)
+{
+  long i = 0, j = s->hist_n;
+
+  while (i < j) {
+    long k = i + (j-i)/2;
+    if (strcmp(s->hist[k].name, name) < 0) i = k+1; else j = k;
+  }
+
+  return i < s->hist_n && !strcmp(s->hist[i].name, name) ? &s->hist[i] : 0;
+}
+
+// -----------------------------------------------------------------------------
+// ----- interface
+// -----------------------------------------------------------------------------
+
+T*
+shard_alloc (int idx, int cnt, const char *hist)
+{
+  assert(cnt > 0 && idx > 0 && idx <= cnt);
+
+  // the accumulation file grows while the shards run, each would see another history
+  ensure(!hist || !option.accum || strcmp(hist, option.accum),
+         "shard history '%s' must be a frozen copy, not the accumulation file", hist);
+
+  T *s = calloc(1, sizeof *s);
+  ensure(s, "out of memory");
+
+  s->load = calloc(cnt, sizeof *s->load);
+  ensure(s->load, "out of memory");
+  s->idx = idx-1, s->cnt = cnt;
+
+  // history, keep the last run of each test
+  if (hist) accum_times(hist, shard_addHist, s);
+  qsort(s->hist, s->hist_n, sizeof *s->hist, shard_cmp);
+
+  long n = 0;
+  for (long i = 0; i < s->hist_n; i++) {
+    if (i+1 < s->hist_n && !strcmp(s->hist[i].name, s->hist[i+1].name)) {
+      free(s->hist[i].name);
+      continue;
+    }
+    s->hist[n++] = s->hist[i];
+  }
+  s->hist_n = n;
+
+  debug("shard %d/%d (%ld tests with history)", idx, cnt, n);
+
+  return s;
+}
+
+void
+shard_free (T *s)
+{
+  if (!s) return;
+
+  for (long i = 0; i < s->hist_n; i++)
+    free(s->hist[i].name);
+
+  free(s->hist);
+  free(s->load);
+  free(s);
+}
+
+int
+shard_take (T *s, const char *test, double size)
+{
+  assert(s);
+
+  const struct hist *h = test ? shard_getHist(s, test) : 0;
+  double w = h ? h->time : size / shard_rate;
+
+  // least loaded shard, first one on ties (same choice in all shards)
+  int k = 0;
+  for (int i = 1; i < s->cnt; i++)
+    if (s->load[i] < s->load[k]) k = i;
+
+  s->load[k] += w > 0 ? w : 1e-9;
+
+  trace("shard: pair '%s' (%.3g s) assigned to shard %d", test ? test : "-", w, k+1);
+
+  return k == s->idx;
+}
+
+#undef T
@@ -0,0 +1,42 @@
+#ifndef SHARD_H
+#define SHARD_H
+
+/*
+ o---------------------------------------------------------------------o
+ |
+ | Ndiff
+ |
+ | Copyright (c) 2012+ laurent.deniau@cern.ch
+ | Gnu General Public License
+ |
+ o---------------------------------------------------------------------o
+
+   Purpose:
+     assign the pairs of files to shards deterministically
+     balance the shards by file size or by the diff times of a frozen history
+
+ o---------------------------------------------------------------------o
+*/
+
+#include "types.h"
+
+// ----- types
+
+struct shard;
+
+// ----- interface
+
+#define T struct shard
+
+// shard idx of cnt (1 <= idx <= cnt), diff times read from the history file (or null),
+// the same inputs must be given to all shards (a copy of the accumulation file)
+T*     shard_alloc (int idx, int cnt, const char *hist);
+void   shard_free  (T*);
+
+// assign the next pair (test name or null, size in bytes) to the least loaded shard,
+// return true if it is this shard
+int    shard_take  (T*, const char *test, double size);
+
+#undef T
+
+#endif
@@ -22,8 +22,10 @@
 
 // ----- types
 
+// 64-bit bounds (rows and columns of huge files), 32-bit stride
 struct slice {
-  uint first, last, stride;
+  ullong first, last;
+  uint   stride;
 };
 
 // ----- interface
@@ -45,53 +47,53 @@ slice_initOne(void)
 static inline T
 slice_initMax(void)
 {
-  return (T){ UINT_MAX, UINT_MAX, 1 };
+  return (T){ ULLONG_MAX, ULLONG_MAX, 1 };
 }
 
 static inline T
 slice_initAll(void)
 {
-  return (T){ 0, UINT_MAX, 1 };
+  return (T){ 0, ULLONG_MAX, 1 };
 }
 
 static inline T
-slice_init(uint first)
+slice_init(ullong first)
 {
   return (T){ first, first, 1 };
 }
 
 static inline T
-slice_initSize(uint first, uint size)
+slice_initSize(ullong first, ullong size)
 {
   ensure(size, "invalid slice size");
 
-  ullong last = first + (ullong)(size-1);
-  if (size == UINT_MAX || last > UINT_MAX) last = UINT_MAX;
+  ullong last = first + (size-1);
+  if (size == ULLONG_MAX || last < first) last = ULLONG_MAX;
 
   return (T){ first, last, 1 };
 }
 
 static inline T
-slice_initSizeStride(uint first, uint size, uint stride)
+slice_initSizeStride(ullong first, ullong size, uint stride)
 {
   ensure(size  , "invalid slice size"  );
   ensure(stride, "invalid slice stride");
 
-  ullong last = first + (ullong)(size-1) * stride;
-  if (size == UINT_MAX || last > UINT_MAX) last = UINT_MAX;
+  ullong last = first + (size-1) * stride;
+  if (size == ULLONG_MAX || (size-1) > (ULLONG_MAX-first) / stride) last = ULLONG_MAX;
 
   return (T){ first, last, stride };
 }
 
 static inline T
-slice_initLast(uint first, uint last)
+slice_initLast(ullong first, ullong last)
 {
   ensure(first <= last, "invalid range bounds");
   return (T){ first, last, 1 };
 }
 
 static inline T
-slice_initLastStride(uint first, uint last, uint stride)
+slice_initLastStride(ullong first, ullong last, uint stride)
 {
   ensure(first <= last, "invalid range bounds");
   ensure(stride       , "invalid range stride");
@@ -99,7 +101,7 @@ slice_initLastStride(uint first, uint last, uint stride)
   return (T){ first, last, stride };
 }
 
-static inline uint
+static inline ullong
 slice_first(const T* s)
 {
   return s->first;
@@ -111,44 +113,43 @@ slice_stride(const T* s)
   return s->stride;
 }
 
-static inline uint
+static inline ullong
 slice_last(const T* s)
 {
   return s->last;
 }
 
-static inline uint
+static inline ullong
 slice_end(const T* s)
 {
-  return s->last > (UINT_MAX-s->stride) ? UINT_MAX : s->last+s->stride;
+  return s->last > (ULLONG_MAX-s->stride) ? ULLONG_MAX : s->last+s->stride;
 }
 
-static inline uint
-slice_get(const T* s, uint n)
+static inline ullong
+slice_get(const T* s, ullong n)
 {
   return s->first + n * s->stride;
 }
 
-static inline uint
-slice_sget(const T* s, uint n)
+static inline ullong
+slice_sget(const T* s, ullong n)
 {
-  ullong at = s->first + (ullong)n * s->stride;
-  ensure(at <= s->last, "index out of range");
-  return at;
+  ensure(n <= (s->last - s->first) / s->stride, "index out of range");
+  return s->first + n * s->stride;
 }
 
-static inline uint
+static inline ullong
 slice_size(const T* s)
 {
-  uint size = (s->last - s->first)/s->stride + 1;
-  return size ? size : UINT_MAX;
+  ullong size = (s->last - s->first)/s->stride + 1;
+  return size ? size : ULLONG_MAX;
 }
 
-static inline uint
+static inline ullong
 slice_width(const T* s)
 {
-  uint width = s->last - s->first + 1;
-  return width ? width : UINT_MAX;
+  ullong width = s->last - s->first + 1;
+  return width ? width : ULLONG_MAX;
 }
 
 static inline bool
@@ -166,7 +167,7 @@ slice_isUnit(const T* s)
 static inline bool
 slice_isInfinite(const T* s)
 {
-  return s->last == UINT_MAX;
+  return s->last == ULLONG_MAX;
 }
 
 static inline bool
@@ -176,19 +177,23 @@ slice_isFull(const T* s)
 }
 
 static inline bool
-slice_isWithin(const T* s, uint n)
+slice_isWithin(const T* s, ullong n)
 {
   return n >= s->first && n <= s->last;
 }
 
 static inline bool
-slice_isEnum(const T* s, uint n)
+slice_isEnum(const T* s, ullong n)
 {
-  return slice_isDense(s) || (n - s->first) % s->stride == 0;
+  if (slice_isDense(s)) return true;
+
+  // 32-bit modulo when the distance fits (most rules)
+  ullong d = n - s->first;
+  return (d <= UINT_MAX ? (uint)d % s->stride : d % s->stride) == 0;
 }
 
 static inline bool
-slice_isElem(const T* s, uint n)
+slice_isElem(const T* s, ullong n)
 {
   return slice_isWithin(s, n) && slice_isEnum(s, n);
 }
@@ -0,0 +1,243 @@
+/*
+ o---------------------------------------------------------------------o
+ |
+ | Ndiff
+ |
+ | Copyright (c) 2012+ laurent.deniau@cern.ch
+ | Gnu General Public License
+ |
+ o---------------------------------------------------------------------o
+
+   Purpose:
+     collect per-stage timing and throughput statistics
+     display statistics per file pair and per test
+
+ o---------------------------------------------------------------------o
+*/
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+
+#ifndef _WIN32
+#include <sys/time.h>
+#include <sys/resource.h>
+#endif
+
+#include "error.h"
+#include "stats.h"
+
+#define T struct stats
+
+// ----- private
+
+static const char *stage_str[stats_stage_n] = {
+  "read", "token", "rule", "test", "reg", "other"
+};
+
+static double
+cpu_now (void)
+{
+  return (double)clock() / CLOCKS_PER_SEC;
+}
+
+static double
+zcpu_now (void)
+{
+#ifndef _WIN32
+  struct rusage ru;
+  if (getrusage(RUSAGE_CHILDREN, &ru)) return 0;
+  return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec +
+        (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) * 1e-6;
+#else
+  return 0;
+#endif
+}
+
+// counters are measured per file pair, their sampled share per stage is scaled
+static void
+stats_printPerf (const T *st, FILE *fp)
+{
+  const double *cyc = st->pmu_total+perf_cycles, *ins = st->pmu_total+perf_instrs;
+
+  fprintf(fp, "   %-14s %14s ", "counter", "total");
+  for (int i = 0; i < stats_stage_n; i++) fprintf(fp, " %6s", stage_str[i]);
+  fprintf(fp, "\n");
+
+  for (int j = 0; j < perf_event_n; j++) {
+    if (!(st->pmu_mask & (1 << j))) continue;
+
+    double sum = 0;
+    for (int i = 0; i < stats_stage_n; i++) sum += st->pmu_stage[i][j];
+
+    fprintf(fp, "   %-14s %14.0f ", perf_name(j), st->pmu_total[j]);
+    for (int i = 0; i < stats_stage_n; i++)
+      fprintf(fp, " %5.1f%%", sum > 0 ? 100 * st->pmu_stage[i][j]/sum : 0);
+    fprintf(fp, "\n");
+  }
+
+  if ((st->pmu_mask & 3) == 3 && *cyc > 0)
+    fprintf(fp, "   %-14s %14.2f\n", "IPC", *ins / *cyc);
+}
+
+// -----------------------------------------------------------------------------
+// ----- interface
+// -----------------------------------------------------------------------------
+
+T*
+stats_alloc (void)
+{
+  T *st = malloc(sizeof *st);
+  ensure(st, "out of memory");
+  st->pmu = 0;
+  stats_clear(st);
+  return st;
+}
+
+void
+stats_free (T *st)
+{
+  free(st);
+}
+
+void
+stats_clear (T *st)
+{
+  assert(st);
+  struct perf *pmu = st->pmu;
+  *st = (T) { .on = false };
+  stats_perf(st, pmu);
+}
+
+void
+stats_perf (T *st, struct perf *pmu)
+{
+  assert(st);
+  st->pmu = pmu;
+  st->pmu_mask = 0;
+  if (pmu) st->pmu_mask = st->pmu_tmask = perf_read(pmu, st->pmu_t0);
+}
+
+double
+stats_now (void)
+{
+#if defined(CLOCK_MONOTONIC) && !defined(_WIN32)
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+#else
+  return cpu_now();
+#endif
+}
+
+void
+stats_lap (T *st, enum stats_stage stage)
+{
+  double t = stats_now();
+  st->stage[stage] += t - st->last;
+  st->last = t;
+
+  // deltas of valid reads only, scaled counts may slightly decrease
+  if (st->pmu) {
+    ullong val[perf_event_n];
+    int m = perf_read(st->pmu, val);
+    for (int i = 0; i < perf_event_n; i++) {
+      if (m & st->pmu_lmask & (1 << i))
+        st->pmu_stage[stage][i] += (llong)(val[i] - st->pmu_last[i]);
+      st->pmu_last[i] = val[i];
+    }
+    st->pmu_lmask = m;
+  }
+}
+
+void
+stats_start (T *st)
+{
+  assert(st);
+  st->on      = false;
+  st->wall_t0 = stats_now();
+  st->cpu_t0  = cpu_now();
+  st->zcpu_t0 = zcpu_now();
+  if (st->pmu) st->pmu_tmask = perf_read(st->pmu, st->pmu_t0);
+}
+
+void
+stats_stop (T *st)
+{
+  assert(st);
+  st->wall += stats_now() - st->wall_t0;
+  st->cpu  += cpu_now()   - st->cpu_t0;
+  st->zcpu += zcpu_now()  - st->zcpu_t0;
+  st->files += 1;
+
+  if (st->pmu) {
+    ullong val[perf_event_n];
+    int m = perf_read(st->pmu, val) & st->pmu_tmask;
+    for (int i = 0; i < perf_event_n; i++)
+      if (m & (1 << i)) st->pmu_total[i] += (llong)(val[i] - st->pmu_t0[i]);
+  }
+  st->on = false;
+}
+
+void
+stats_add (T *st, const T *st2)
+{
+  assert(st && st2);
+
+  st->lhs_bytes += st2->lhs_bytes;
+  st->rhs_bytes += st2->rhs_bytes;
+  st->lines     += st2->lines;
+  st->numbers   += st2->numbers;
+  st->tests     += st2->tests;
+  st->files     += st2->files;
+  st->wall      += st2->wall;
+  st->cpu       += st2->cpu;
+  st->zcpu      += st2->zcpu;
+
+  if (st->buf_max < st2->buf_max) st->buf_max = st2->buf_max;
+  if (st->cxt_mem < st2->cxt_mem) st->cxt_mem = st2->cxt_mem;
+
+  for (int i = 0; i < stats_stage_n; i++)
+    st->stage[i] += st2->stage[i];
+
+  st->pmu_mask |= st2->pmu_mask;
+  for (int j = 0; j < perf_event_n; j++) {
+    st->pmu_total[j] += st2->pmu_total[j];
+    for (int i = 0; i < stats_stage_n; i++)
+      st->pmu_stage[i][j] += st2->pmu_stage[i][j];
+  }
+}
+
+void
+stats_print (const T *st, FILE *fp, const char *title)
+{
+  assert(st && fp);
+
+  double sum = 0, wall = st->wall > 0 ? st->wall : 1e-9;
+  for (int i = 0; i < stats_stage_n; i++) sum += st->stage[i];
+
+  fprintf(fp, " ~ stats %s (%d file%s)\n", title ? title : "", st->files, st->files > 1 ? "s" : "");
+  fprintf(fp, "   bytes   %12lld|%-12lld  lines %10lld  numbers %12lld  comparisons %12lld\n",
+              st->lhs_bytes, st->rhs_bytes, st->lines, st->numbers, st->tests);
+  fprintf(fp, "   buffer  %12ld B  context %10ld B  wall %8.3f s  cpu %8.3f s  unzip cpu (children) %8.3f s\n",
+              st->buf_max, st->cxt_mem, st->wall, st->cpu, st->zcpu);
+  fprintf(fp, "   rate    %12.1f MB/s  %10.3g numbers/s\n",
+              (st->lhs_bytes + st->rhs_bytes) / wall * 1e-6, st->numbers / wall);
+
+  if (st->pmu_mask) stats_printPerf(st, fp);
+
+  if (!(sum > 0)) return;
+
+  // sampled stages are scaled to the measured wall and cpu times, i.e. estimates
+  // (the cpu share per stage is assumed to follow the wall share)
+  fprintf(fp, "   stages  (estimates) sampled 1 row in %d, wall share applied to the measured wall and cpu\n",
+              STATSAMPLE);
+  for (int i = 0; i < stats_stage_n; i++)
+    fprintf(fp, "   %-6s  wall %8.3f s  cpu %8.3f s  %5.1f%%\n", stage_str[i],
+                st->wall * st->stage[i]/sum, st->cpu * st->stage[i]/sum, 100 * st->stage[i]/sum);
+}
+
+#undef T
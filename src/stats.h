@@ -0,0 +1,101 @@
+#ifndef STATS_H
+#define STATS_H
+
+/*
+ o---------------------------------------------------------------------o
+ |
+ | Ndiff
+ |
+ | Copyright (c) 2012+ laurent.deniau@cern.ch
+ | Gnu General Public License
+ |
+ o---------------------------------------------------------------------o
+
+   Purpose:
+     collect per-stage timing and throughput statistics
+     display statistics per file pair and per test
+
+ o---------------------------------------------------------------------o
+*/
+
+#include <stdio.h>
+#include "types.h"
+#include "perf.h"
+
+// ----- constants
+
+// one row out of STATSAMPLE is timed (must be a power of 2)
+#ifndef STATSAMPLE
+#define STATSAMPLE 16
+#endif
+
+enum stats_stage {
+  stats_read,   // readLine, skipLine, gotoLine, gotoNum
+  stats_token,  // nextNum
+  stats_rule,   // context_getInc (and getAt in xcheck mode)
+  stats_test,   // testNum (without registers)
+  stats_reg,    // registers evaluation
+  stats_other,  // result lines and loop overhead
+
+  stats_stage_n
+};
+
+// ----- types
+
+struct stats {
+  // counters
+  llong  lhs_bytes, rhs_bytes;
+  llong  lines, numbers, tests;
+  long   buf_max, cxt_mem;
+  int    files;
+
+  // sampled time per stage (s)
+  double stage[stats_stage_n];
+  double last;
+  bool   on;
+
+  // measured time (s)
+  double wall, cpu, zcpu;
+  double wall_t0, cpu_t0, zcpu_t0;
+
+  // hardware counters (optional), sampled per stage and measured
+  struct perf *pmu;
+  int    pmu_mask, pmu_lmask, pmu_tmask; // events available, valid in last and t0
+  double pmu_stage[stats_stage_n][perf_event_n];
+  double pmu_total[perf_event_n];
+  ullong pmu_last[perf_event_n], pmu_t0[perf_event_n];
+};
+
+// ----- interface
+
+#define T struct stats
+
+T*     stats_alloc  (void);
+void   stats_free   (T*);
+void   stats_clear  (T*);
+
+// measured region (one file pair), stop after closing the files (unzip)
+void   stats_start  (T*);
+void   stats_stop   (T*);
+void   stats_add    (T*, const T*);
+void   stats_perf   (T*, struct perf*); // attach counters (not owned)
+
+// sampled timing of stages
+double stats_now    (void);
+void   stats_lap    (T*, enum stats_stage);
+
+static inline void
+stats_row (T *st, llong row)
+{
+  if (st->on) stats_lap(st, stats_other);
+  if ((st->on = !((row-1) & (STATSAMPLE-1)))) {
+    st->last = stats_now();
+    if (st->pmu) st->pmu_lmask = perf_read(st->pmu, st->pmu_last);
+  }
+}
+
+void   stats_print  (const T*, FILE*, const char *title);
+
+#undef T
+
+#endif
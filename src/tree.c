@@ -0,0 +1,552 @@
+/*
+ o---------------------------------------------------------------------o
+ |
+ | Ndiff
+ |
+ | Copyright (c) 2012+ laurent.deniau@cern.ch
+ | Gnu General Public License
+ |
+ o---------------------------------------------------------------------o
+
+   Purpose:
+     walk directory trees of output, reference and config files
+     pair files by stem (or outputs with one reference)
+     and diff the pairs on a pool of worker processes
+     report results in sorted path order (POSIX only)
+
+ o---------------------------------------------------------------------o
+*/
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <sys/stat.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#endif
+
+#include "args.h"
+#include "error.h"
+#include "utils.h"
+#include "shard.h"
+#include "tree.h"
+
+#define T struct tree
+
+// ----- constants
+
+// pending (unreported) pairs per worker, bound the number of open capture files
+enum { PENDING = 8, COPYSIZ = 1 << 16 };
+
+// file kinds
+enum { out_k, ref_k, cfg_k, kind_n };
+
+// ----- types
+
+struct entry {
+  char *path;             // relative to the tree root
+  char *stem;             // path without compression and kind extensions
+  int   bare;             // output without extension, kept only if paired
+};
+
+struct list {
+  struct entry *ent;
+  int n, max;
+};
+
+struct scan {
+  const char  *root;
+  struct list *lst[kind_n]; // null when the kind is not collected from this root
+  int          err;
+#ifndef _WIN32
+  pthread_t    thr;
+#endif
+};
+
+struct pair {
+  char *lhs, *rhs, *cfg;  // full paths, lhs or rhs null when missing
+};
+
+struct tree {
+  struct list  lst[kind_n];
+  struct pair *pair;
+  int          n;
+};
+
+// ----- private
+
+static int worker;
+
+static char*
+tree_dup (const char *str)
+{
+  if (!str) return 0;
+  char *s = malloc(strlen(str)+1);
+  ensure(s, "out of memory");
+  return strcpy(s, str);
+}
+
+static char*
+tree_path (const char *root, const char *path)
+{
+  size_t n = strlen(root), m = strlen(path);
+  char *s = malloc(n+m+2);
+  ensure(s, "out of memory");
+  memcpy(s, root, n);
+  s[n] = '/';
+  memcpy(s+n+1, path, m+1);
+  return s;
+}
+
+static int
+tree_cmp (const void *a_, const void *b_)
+{
+  const struct entry *a = a_, *b = b_;
+  int c = strcmp(a->stem, b->stem);
+  if (!c) c = a->bare - b->bare;
+  return c ? c : strcmp(a->path, b->path);
+}
+
+static void
+list_add (struct list *l, const char *path, size_t len, const char *ext, int bare)
+{
+  if (l->n == l->max) {
+    l->max = l->max ? 2*l->max : 256;
+    l->ent = realloc(l->ent, l->max * sizeof *l->ent);
+    ensure(l->ent, "out of memory");
+  }
+
+  char *s = malloc(2*len+2);
+  ensure(s, "out of memory");
+  memcpy(s      , path, len+1);
+  memcpy(s+len+1, path, len+1);
+
+  struct entry *e = &l->ent[l->n++];
+  e->path = s, e->stem = s+len+1, e->bare = bare;
+
+  // remove compression and kind extensions
+  char *dot = strrchr(e->stem, '.');
+  if (dot && is_zipext(dot)) *dot = 0;
+  dot = strrchr(e->stem, '.');
+  if (dot && ext && !strcmp(dot, ext)) *dot = 0;
+}
+
+static void
+list_clear (struct list *l)
+{
+  for (int i=0; i < l->n; i++)
+    free(l->ent[i].path);
+  free(l->ent);
+}
+
+#ifndef _WIN32
+
+// artefacts of ndiff itself: incremental digests and zcache entries
+static int
+scan_artefact (const char *name, const char *dot)
+{
+  // file.incr and file.incr.tmp
+  if (!strcmp(dot, ".incr")) return 1;
+  if (!strcmp(dot, ".tmp") && dot-name >= 5 && !strncmp(dot-5, ".incr", 5)) return 1;
+
+  if (dot - name != 16 || (strcmp(dot, ".lck") && strcmp(dot, ".txt") && strcmp(dot, ".tmp")))
+    return 0;
+
+  while (name < dot && strchr("0123456789abcdef", *name)) name++;
+  return name == dot;
+}
+
+// classify a regular file (relative path) by its extension before compression
+static void
+scan_file (struct scan *s, const char *path)
+{
+  const char *ext[kind_n] = { option.out_e, option.ref_e, option.cfg_e };
+  size_t len = strlen(path);
+  char buf[FILENAME_MAX];
+
+  memcpy(buf, path, len+1);
+  char *name = strrchr(buf, '/');
+  name = name ? name+1 : buf;
+  char *dot = strrchr(name, '.');
+  if (dot && is_zipext(dot)) *dot = 0;
+  dot = strrchr(name, '.');
+
+  // outputs without extension are kept only if their stem has a reference
+  if (!dot) {
+    if (s->lst[out_k]) list_add(s->lst[out_k], path, len, 0, 1);
+    return;
+  }
+
+  if (scan_artefact(name, dot)) return;
+
+  for (int k=0; k < kind_n; k++)
+    if (!strcmp(dot, ext[k])) {
+      if (s->lst[k]) list_add(s->lst[k], path, len, ext[k], 0);
+      return;
+    }
+}
+
+// relative descent from fd, path holds the current relative prefix of length len
+static void
+scan_dir (struct scan *s, int fd, char *path, size_t len)
+{
+  DIR *dir = fdopendir(fd);
+  if (!dir) { close(fd); ++s->err; return; }
+
+  struct dirent *e;
+  while ((e = readdir(dir))) {
+    const char *name = e->d_name;
+    if (name[0] == '.' && (!name[1] || (name[1] == '.' && !name[2]))) continue;
+
+    size_t n = strlen(name);
+    if (len+n+2 > FILENAME_MAX) { ++s->err; continue; }
+    memcpy(path+len, name, n+1);
+
+    // resolve unknown types and links (links to directories are not followed)
+    int type = e->d_type;
+    if (type == DT_UNKNOWN || type == DT_LNK) {
+      struct stat st;
+      if (fstatat(dirfd(dir), name, &st, 0)) continue;
+      if (S_ISREG(st.st_mode)) type = DT_REG;
+      else if (S_ISDIR(st.st_mode) && type == DT_UNKNOWN) type = DT_DIR;
+      else continue;
+    }
+
+    if (type == DT_REG) scan_file(s, path);
+    else if (type == DT_DIR) {
+      int sub = openat(dirfd(dir), name, O_RDONLY | O_DIRECTORY);
+      if (sub < 0) { ++s->err; continue; }
+      path[len+n] = '/', path[len+n+1] = 0;
+      scan_dir(s, sub, path, len+n+1);
+    }
+  }
+
+  closedir(dir);
+}
+
+static void*
+scan_run (void *s_)
+{
+  struct scan *s = s_;
+  char path[FILENAME_MAX] = "";
+
+  int fd = open(s->root, O_RDONLY | O_DIRECTORY);
+  if (fd < 0) { s->err = -1; return 0; }
+
+  scan_dir(s, fd, path, 0);
+  return 0;
+}
+
+// walk the distinct roots concurrently, one thread per root
+static void
+tree_scan (T *t, const char *root[kind_n])
+{
+  struct scan scan[kind_n];
+  int n = 0;
+
+  for (int k=0; k < kind_n; k++) {
+    int i = 0;
+    while (i < n && strcmp(scan[i].root, root[k])) i++;
+    if (i == n) {
+      memset(&scan[n], 0, sizeof scan[n]);
+      scan[n++].root = root[k];
+    }
+    scan[i].lst[k] = &t->lst[k];
+  }
+
+  for (int i=0; i < n; i++)
+    ensure(!pthread_create(&scan[i].thr, 0, scan_run, &scan[i]), "unable to create thread");
+
+  for (int i=0; i < n; i++) {
+    pthread_join(scan[i].thr, 0);
+    ensure(scan[i].err >= 0, "invalid directory '%s'", scan[i].root);
+    if (scan[i].err)
+      warning("%d entries of '%s' could not be read", scan[i].err, scan[i].root);
+  }
+}
+
+static void
+tree_copy (FILE *dst, FILE *src)
+{
+  char buf[COPYSIZ];
+  size_t n;
+
+  fflush(src);
+  rewind(src);
+  while ((n = fread(buf, 1, sizeof buf, src)) > 0)
+    fwrite(buf, 1, n, dst);
+  fflush(dst);
+}
+
+#endif
+
+// missing pairs are reported by the caller process, return 0 if not a full pair
+static int
+tree_check (const struct pair *p, struct tree_res *r)
+{
+  if (!p->lhs) {
+    warning("output file for reference '%s' not found, skipping diff", p->rhs);
+    r->total = r->failed = 1;
+    return 0;
+  }
+
+  if (!p->rhs) {
+    warning("reference file for output '%s' not found, skipping diff", p->lhs);
+    r->total = r->failed = 1;
+    return 0;
+  }
+
+  return 1;
+}
+
+static void
+tree_add (struct tree_res *res, const struct tree_res *r)
+{
+  res->total   += r->total;
+  res->failed  += r->failed;
+  res->lines   += r->lines;
+  res->numbers += r->numbers;
+}
+
+// -----------------------------------------------------------------------------
+// ----- interface
+// -----------------------------------------------------------------------------
+
+T*
+tree_alloc (const char *lhs_dir, const char *rhs_dir, const char *cfg_dir)
+{
+  assert(lhs_dir && rhs_dir);
+
+#ifdef _WIN32
+  error("tree mode is not supported on this platform");
+  return 0;
+#else
+  const char *root[kind_n] = { lhs_dir, rhs_dir, cfg_dir ? cfg_dir : rhs_dir };
+
+  T *t = calloc(1, sizeof *t);
+  ensure(t, "out of memory");
+
+  tree_scan(t, root);
+
+  // sort by stem, duplicated stems (e.g. compressed and plain) keep the first path,
+  // outputs without extension sort last and are dropped silently
+  for (int k=0; k < kind_n; k++) {
+    struct list *l = &t->lst[k];
+    qsort(l->ent, l->n, sizeof *l->ent, tree_cmp);
+    int j = 0;
+    for (int i=0; i < l->n; i++) {
+      if (j && !strcmp(l->ent[j-1].stem, l->ent[i].stem)) {
+        if (!l->ent[i].bare)
+          warning("file '%s/%s' ignored, same stem as '%s/%s'",
+                  root[k], l->ent[i].path, root[k], l->ent[j-1].path);
+        free(l->ent[i].path);
+        continue;
+      }
+      l->ent[j++] = l->ent[i];
+    }
+    l->n = j;
+  }
+
+  // merge lists by stem
+  const struct list *lo = &t->lst[out_k], *lr = &t->lst[ref_k], *lc = &t->lst[cfg_k];
+  t->pair = malloc((lo->n + lr->n + 1) * sizeof *t->pair);
+  ensure(t->pair, "out of memory");
+
+  for (int i=0, j=0, c=0; i < lo->n || j < lr->n; t->n++) {
+    struct pair *p = &t->pair[t->n];
+    const char *stem;
+    int cmp = i == lo->n ? 1 : j == lr->n ? -1 : strcmp(lo->ent[i].stem, lr->ent[j].stem);
+
+    // unpaired files without extension are not outputs (e.g. notes, makefiles)
+    if (cmp < 0 && lo->ent[i].bare) { i++, t->n--; continue; }
+
+    p->lhs = cmp <= 0 ? tree_path(root[out_k], lo->ent[i].path) : 0;
+    p->rhs = cmp >= 0 ? tree_path(root[ref_k], lr->ent[j].path) : 0;
+    stem   = cmp <= 0 ? lo->ent[i].stem : lr->ent[j].stem;
+    if (cmp <= 0) i++;
+    if (cmp >= 0) j++;
+
+    while (c < lc->n && strcmp(lc->ent[c].stem, stem) < 0) c++;
+    p->cfg = c < lc->n && !strcmp(lc->ent[c].stem, stem) && p->lhs && p->rhs ?
+             tree_path(root[cfg_k], lc->ent[c].path) : 0;
+  }
+
+  debug("tree '%s'|'%s' paired %d entries (%d outputs, %d references, %d configs)",
+        lhs_dir, rhs_dir, t->n, lo->n, lr->n, lc->n);
+
+  return t;
+#endif
+}
+
+T*
+tree_list (const char *lhs[], int n, const char *rhs, const char *cfg)
+{
+  assert(lhs && rhs && n >= 0);
+
+  T *t = calloc(1, sizeof *t);
+  ensure(t, "out of memory");
+
+  t->pair = malloc((n+1) * sizeof *t->pair);
+  ensure(t->pair, "out of memory");
+
+  for (; t->n < n; t->n++)
+    t->pair[t->n] = (struct pair) { tree_dup(lhs[t->n]), tree_dup(rhs), tree_dup(cfg) };
+
+  debug("list of %d outputs paired with reference '%s'", n, rhs);
+
+  return t;
+}
+
+void
+tree_free (T *t)
+{
+  if (!t) return;
+
+  for (int i=0; i < t->n; i++) {
+    free(t->pair[i].lhs);
+    free(t->pair[i].rhs);
+    free(t->pair[i].cfg);
+  }
+  for (int k=0; k < kind_n; k++)
+    list_clear(&t->lst[k]);
+
+  free(t->pair);
+  free(t);
+}
+
+void
+tree_shard (T *t, struct shard *s)
+{
+  assert(t && s);
+
+  int n = 0;
+  for (int i=0; i < t->n; i++) {
+    struct pair *p = &t->pair[i];
+    struct stat st;
+    double size = stat(p->lhs ? p->lhs : p->rhs, &st) ? 0 : (double)st.st_size;
+
+    if (shard_take(s, 0, size)) { t->pair[n++] = *p; continue; }
+
+    free(p->lhs);
+    free(p->rhs);
+    free(p->cfg);
+  }
+
+  debug("tree shard kept %d of %d entries", n, t->n);
+  t->n = n;
+}
+
+int
+tree_worker (void)
+{
+  return worker;
+}
+
+void
+tree_run (T *t, int jobs, tree_fun *fun, struct tree_res *res)
+{
+  assert(t && fun && res);
+
+#ifndef _WIN32
+  if (jobs <= 0) jobs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#else
+  jobs = 1; // no worker processes
+#endif
+  if (jobs <= 0 || jobs > t->n) jobs = t->n > 0 ? t->n : 1;
+
+  debug("tree diff of %d entries using %d job(s)", t->n, jobs);
+
+  // sequential, in process
+  if (jobs == 1) {
+    for (int i=0; i < t->n; i++) {
+      struct tree_res r = { 0 };
+      const struct pair *p = &t->pair[i];
+      if (tree_check(p, &r)) fun(p->lhs, p->rhs, p->cfg, &r);
+      tree_add(res, &r);
+    }
+    return;
+  }
+
+#ifndef _WIN32
+  // counters shared with the workers, captured outputs and workers per pair
+  struct tree_res *r = mmap(0, t->n * sizeof *r, PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  ensure(r != MAP_FAILED, "unable to map shared memory");
+  memset(r, 0, t->n * sizeof *r);
+
+  struct { FILE *out, *err; pid_t pid; int done; } *w = calloc(t->n, sizeof *w);
+  ensure(w, "out of memory");
+
+  int run = 0, beg = 0, end = 0;
+
+  while (beg < t->n) {
+    // report completed pairs in order
+    if (w[beg].done) {
+      if (w[beg].out) {
+        tree_copy(stdout, w[beg].out);
+        tree_copy(stderr, w[beg].err);
+        fclose(w[beg].out);
+        fclose(w[beg].err);
+      } else
+        tree_check(&t->pair[beg], &r[beg]);
+      tree_add(res, &r[beg++]);
+      continue;
+    }
+
+    // start next pair
+    if (end < t->n && run < jobs && end-beg < PENDING*jobs) {
+      const struct pair *p = &t->pair[end];
+
+      if (!p->lhs || !p->rhs) { w[end++].done = 1; continue; }
+
+      w[end].out = tmpfile();
+      w[end].err = tmpfile();
+      ensure(w[end].out && w[end].err, "unable to create temporary file");
+
+      fflush(stdout);
+      fflush(stderr);
+
+      pid_t pid = fork();
+      ensure(pid >= 0, "unable to create worker process");
+
+      if (!pid) {
+        worker = 1;
+        dup2(fileno(w[end].out), STDOUT_FILENO);
+        dup2(fileno(w[end].err), STDERR_FILENO);
+        fun(p->lhs, p->rhs, p->cfg, &r[end]);
+        exit(EXIT_SUCCESS);
+      }
+
+      w[end++].pid = pid, ++run;
+      continue;
+    }
+
+    // wait for a worker
+    int st;
+    pid_t pid = wait(&st);
+    ensure(pid > 0, "unable to wait for worker process");
+
+    for (int i=beg; i < end; i++)
+      if (w[i].pid == pid) {
+        if (!WIFEXITED(st) || WEXITSTATUS(st) != EXIT_SUCCESS)
+          r[i].total = r[i].failed = 1;
+        w[i].done = 1, --run;
+        break;
+      }
+  }
+
+  free(w);
+  munmap(r, t->n * sizeof *r);
+#endif
+}
+
+#undef T
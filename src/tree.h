@@ -0,0 +1,58 @@
+#ifndef TREE_H
+#define TREE_H
+
+/*
+ o---------------------------------------------------------------------o
+ |
+ | Ndiff
+ |
+ | Copyright (c) 2012+ laurent.deniau@cern.ch
+ | Gnu General Public License
+ |
+ o---------------------------------------------------------------------o
+
+   Purpose:
+     walk directory trees of output, reference and config files
+     pair files by stem (or outputs with one reference)
+     and diff the pairs on a pool of worker processes
+     report results in sorted path order (POSIX only)
+
+ o---------------------------------------------------------------------o
+*/
+
+#include "types.h"
+
+// ----- types
+
+struct tree;
+struct shard;
+
+struct tree_res {
+  int   total, failed;
+  llong lines, numbers;
+};
+
+// diff one pair of files (cfg can be null), fill the counters of the pair
+typedef void (tree_fun)(const char *lhs, const char *rhs, const char *cfg, struct tree_res*);
+
+// ----- interface
+
+#define T struct tree
+
+T*   tree_alloc  (const char *lhs_dir, const char *rhs_dir, const char *cfg_dir);
+// pair the n outputs with one reference (cfg can be null)
+T*   tree_list   (const char *lhs[], int n, const char *rhs, const char *cfg);
+void tree_free   (T*);
+
+// keep the pairs assigned to this shard
+void tree_shard  (T*, struct shard*);
+
+// diff the pairs using up to jobs processes (0 = online cpus), accumulate counters in res
+void tree_run    (T*, int jobs, tree_fun*, struct tree_res *res);
+
+// true inside a worker process
+int  tree_worker (void);
+
+#undef T
+
+#endif
@@ -23,6 +23,7 @@ typedef unsigned char          bool;
 typedef unsigned int           uint;
 typedef unsigned long int      ulong;
 typedef unsigned long long int ullong;
+typedef          long long int llong;
 
 enum { false, true };
 
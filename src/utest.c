@@ -9,7 +9,7 @@
  o---------------------------------------------------------------------o
   
    Purpose:
-     manage unit tests
+     manage unit tests and microbenchmarks
      display results
  
  o---------------------------------------------------------------------o
@@ -23,6 +23,7 @@
 
 #include "utils.h"
 #include "utest.h"
+#include "stats.h"
 #include "error.h"
 
 // ----- constants
@@ -31,7 +32,20 @@
 #define MAXUTESTKEEP 25
 #endif
 
-enum { UTEST_KEEP = MAXUTESTKEEP };
+// benchmarks: repetitions, warmup and minimum time per repetition (s)
+#ifndef MAXUBENCHREP
+#define MAXUBENCHREP 31
+#endif
+
+#ifndef MAXUBENCHWARM
+#define MAXUBENCHWARM 3
+#endif
+
+#ifndef MINUBENCHTIME
+#define MINUBENCHTIME 2e-3
+#endif
+
+enum { UTEST_KEEP = MAXUTESTKEEP, UBENCH_REP = MAXUBENCHREP };
 
 // ----- types
 
@@ -162,3 +176,59 @@ utest_stat(struct utest *ut)
     ut->total_fail ? fail_str : pass_str);
 }
 
+
+// ----- benchmarks
+
+static int
+cmp_dbl(const void *a, const void *b)
+{
+  double x = *(const double*)a, y = *(const double*)b;
+  return (x > y) - (x < y);
+}
+
+static double
+median(double *t, int n)
+{
+  qsort(t, n, sizeof *t, cmp_dbl);
+  return n & 1 ? t[n/2] : (t[n/2-1] + t[n/2]) / 2;
+}
+
+static double
+bench_run(void (*fun)(void*, long), void *arg, long n)
+{
+  double t0 = stats_now();
+  fun(arg, n);
+  return stats_now() - t0;
+}
+
+double
+utest_bench(struct utest *ut, const char *name, void (*fun)(void*, long), void *arg)
+{
+  assert(ut && name && fun);
+
+  double t[UBENCH_REP], dev[UBENCH_REP];
+  long n = 1;
+
+  // calibrate the number of calls per repetition (also warmup)
+  while (bench_run(fun, arg, n) < MINUBENCHTIME && n < (1L << 40)) n *= 2;
+
+  for (int i = 0; i < MAXUBENCHWARM; i++)
+    bench_run(fun, arg, n);
+
+  for (int i = 0; i < UBENCH_REP; i++)
+    t[i] = bench_run(fun, arg, n) * 1e9 / n;
+
+  // robust statistics: median and median absolute deviation
+  double med = median(t, UBENCH_REP), min = t[0];
+
+  for (int i = 0; i < UBENCH_REP; i++)
+    dev[i] = fabs(t[i] - med);
+
+  double mad = median(dev, UBENCH_REP);
+
+  fprintf(ut->out, "bench name=%s median_ns=%.3f mad_ns=%.3f min_ns=%.3f reps=%d calls=%ld\n",
+          name, med, mad, min, UBENCH_REP, n);
+  fflush(ut->out);
+
+  return med;
+}
@@ -12,7 +12,7 @@
  o---------------------------------------------------------------------o
   
    Purpose:
-     manage unit tests
+     manage unit tests and microbenchmarks
      display results
  
  o---------------------------------------------------------------------o
@@ -38,6 +38,10 @@ void utest_stat  (T*);
 // return the number of failed tests, prefer the UTEST macro
 int  utest_test  (T*, int pass, const char *cond, const char *file, int line);
 
+// run fun(arg, n) that calls the benchmarked primitive n times,
+// print one machine-readable line and return the median time per call (ns)
+double utest_bench (T*, const char *name, void (*fun)(void*, long), void *arg);
+
 #undef T
 
 // ----- macros
@@ -21,10 +21,18 @@
 #include <string.h>
 #include <assert.h>
 #include <time.h>
+#include <sys/stat.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#endif
 
 #include "error.h"
 #include "utils.h"
 #include "args.h"
+#include "zcache.h"
 
 #ifdef _WIN32
 #ifndef popen
@@ -73,7 +81,7 @@ const zipext[] = {
 
 // functions 
 
-static bool
+bool
 is_zipext(const char *str)
 {
   for (int i = 0; zipext[i].ext; i++)
@@ -87,11 +95,27 @@ void
 close_file(FILE *fp, int zip)
 {
   if (fp && fp != stdin && fp != stdout) {
-    if (zip) pclose(fp);
+    if (zip) { if (!zcache_close(fp)) pclose(fp); }
     else     fclose(fp);
   }
 }
 
+double
+file_size(const char* str, const char *ext)
+{
+  char buf[FILENAME_MAX+100];
+  struct stat st;
+
+  for (int i=0; zipext[i].ext; i++) {
+    snprintf(buf, sizeof buf, "%s%s%s", str, ext, zipext[i].ext);
+    if (!stat(buf, &st)) return (double)st.st_size;
+    snprintf(buf, sizeof buf, "%s%s", str, zipext[i].ext);
+    if (!stat(buf, &st)) return (double)st.st_size;
+  }
+
+  return 0;
+}
+
 FILE*
 open_file(const char* str, FILE **res_fp, int *idx, const char *ext, int optext, int required)
 {
@@ -180,10 +204,17 @@ retry:
   if (zid) {
     char zbuf[2*(FILENAME_MAX+100)];
     fclose(fp);
-    sprintf(zbuf, "%s %s", option.unzip[zid-1], buf);
-    debug("trying to reopen compressed file '%s' for reading", zbuf);
-    fp = popen(zbuf, "r");
-    ensure(fp, "failed to execute '%s'", zbuf);
+
+    // shared cache of decompressed references, if any
+    fp = option.zcache && ext == option.ref_e ?
+         zcache_open(option.zcache, option.zcache_max, buf, option.unzip[zid-1]) : 0;
+
+    if (!fp) {
+      sprintf(zbuf, "%s %s", option.unzip[zid-1], buf);
+      debug("trying to reopen compressed file '%s' for reading", zbuf);
+      fp = popen(zbuf, "r");
+      ensure(fp, "failed to execute '%s'", zbuf);
+    }
   }
 
   // resize buffer for faster read
@@ -219,6 +250,12 @@ filename:
     strncpy(rbuf, buf         , sizeof rbuf-1); rbuf[sizeof rbuf-1]=0;
     strncat(rbuf, option.res_e, sizeof rbuf-1); rbuf[sizeof rbuf-1]=0;
     *res_fp = fopen(rbuf, "w");
+
+    // resize buffer for faster write
+    if (*res_fp && setvbuf(*res_fp, 0, _IOFBF, 1 << 20)) {
+      fclose(*res_fp);
+      error("unable to resize the stream buffer size");
+    }
   }
 
   // debug information
@@ -228,74 +265,398 @@ filename:
   return fp;
 }
 
+// same as skipLine and readLine without stream locking,
+// for bulk skips of many lines and for the diff loop (streams held)
+
+int
+skipLineFast(FILE *fp, int *i_)
+{
+  return skipLine_tpl(fp, i_, true);
+}
+
+int
+readLineFast(FILE *fp, char *buf, int n, int *i_)
+{
+  return readLine_tpl(fp, buf, n, i_, true);
+}
+
+// skip n lines at once, chunks are scanned for line ends (same as skipLine)
+// and the stream is moved back after the last one, line by line if not seekable
+
+#ifdef _WIN32
+#define fseeko(fp, o, w) _fseeki64(fp, o, w)
+#define ftello(fp)       _ftelli64(fp)
+#endif
+
+llong
+skipLinesBulk(FILE *fp, llong n, llong *s_)
+{
+  char buf[65536];
+  llong i = 0, s = 0;
+  size_t k;
+  bool cr = false; // \r ending the last line, \n may follow
+
+  if (ftello(fp) < 0) {
+    int c = 0, m;
+    while (i < n && c != EOF)
+      c = skipLineFast(fp, &m), s += m + (c == '\n'), i++;
+    if (s_) *s_ = s;
+    return i;
+  }
+
+  while ((i < n || cr) && (k = fread(buf, 1, sizeof buf, fp)) > 0) {
+    const char *p = buf, *e = buf+k, *q;
+
+    if (!cr && !memchr(buf, '\r', k)) {
+      while (i < n && (q = memchr(p, '\n', e-p))) p = q+1, i++;
+      if (i < n) p = e;
+    } else
+      while (p < e) {
+        if (cr) { cr = false; if (*p == '\n') { p++; continue; } }
+        if (i == n) break;
+        if (*p == '\n') i++;
+        else if (*p == '\r') i++, cr = true;
+        p++;
+      }
+
+    s += p-buf;
+    if (p < e) {
+      ensure(!fseeko(fp, -(llong)(e-p), SEEK_CUR), "unable to seek input file");
+      break;
+    }
+  }
+
+  if (s_) *s_ = s;
+  return i;
+}
+
+// accumulation log: one record per test appended under an exclusive lock,
+// merged into the summary on demand (--summary) or per test (--history),
+// the logs of shards are merged into one suite (--merge-accum)
+//   = reset <time>
+//   + <time> <diff time> <lines> <numbers> <files> <failed> <test name>
+
+static void
+accum_write(const char *rec, size_t len)
+{
+#ifndef _WIN32
+  int fd = open(option.accum, O_WRONLY | O_CREAT | O_APPEND, 0666);
+  ensure(fd >= 0, "failed to open accumulation file %s", option.accum);
+  ensure(!flock(fd, LOCK_EX), "failed to lock accumulation file %s", option.accum);
+
+  ssize_t n = write(fd, rec, len);
+
+  flock(fd, LOCK_UN);
+  close(fd);
+  ensure(n == (ssize_t)len, "failed to write accumulation file %s", option.accum);
+#else
+  FILE *fp = fopen(option.accum, "a");
+  ensure(fp, "failed to open accumulation file %s", option.accum);
+  size_t n = fwrite(rec, 1, len, fp);
+  fclose(fp);
+  ensure(n == len, "failed to write accumulation file %s", option.accum);
+#endif
+}
+
+static int
+accum_format(char *rec, size_t siz, long long t, double ndtime, llong lines, llong numbers,
+             int total, int failed, const char *name)
+{
+  int n = snprintf(rec, siz, "+ %lld %.6f %lld %lld %d %d %.*s\n",
+                   t, ndtime, lines, numbers, total, failed, FILENAME_MAX, name);
+
+  return (size_t)n < siz ? n : (int)siz-1;
+}
+
+void
+accum_append(int total, int failed, llong lines, llong numbers)
+{
+  if (!option.accum || !total) return;
+
+  char rec[FILENAME_MAX+128];
+  double ndtime = (option.clk_t1 - option.clk_t0) / CLOCKS_PER_SEC;
+
+  int n = accum_format(rec, sizeof rec, (long long)time(0), ndtime, lines, numbers,
+                       total, failed, option.test ? option.test : "-");
+
+  accum_write(rec, n);
+}
+
 void
-accum_summary(int total, int failed, long lines, long numbers)
+accum_reset(void)
 {
   if (!option.accum) return;
 
-  int n;
-  double tz;
-  struct tm tm;
-  time_t now = time(0);
-  int total_tests=0, total_passed=0, total_failed=0;
-  long total_lines=0, total_numbers=0;
-  double total_ndtime=0;
+  char rec[64];
+  int n = snprintf(rec, sizeof rec, "= reset %lld\n", (long long)time(0));
+  accum_write(rec, n);
+}
+
+// ----- log reader
+
+struct accum_rec {
+  long long t;
+  double    ndtime;
+  llong     lines, numbers;
+  int       total, failed, idx;
+  char     *name;
+};
+
+// summary of the old format (before the log), converted to a reset at its start
+// time followed by one record of its totals, return 0 if buf is not its header
+static int
+accum_legacy(FILE *fp, const char *file, const char *buf, struct accum_rec *r, long long *t0_)
+{
+  struct tm tm = { 0 };
+  char line[256];
+  double runtime = 0;
+  int passed = 0;
+
+  if (sscanf(buf, " = tests summary (started at %d.%d.%d %d:%d:%d %d)",
+                  &tm.tm_year, &tm.tm_mon, &tm.tm_mday,
+                  &tm.tm_hour, &tm.tm_min, &tm.tm_sec, &tm.tm_isdst) != 7)
+    return 0;
+
+  tm.tm_year -= 1900;
+  tm.tm_mon  -= 1;
+
+  ensure(fgets(line, sizeof line, fp) &&
+         sscanf(line, "   total diff time %lf s  -  total lines %lld  -  total numbers %lld",
+                &r->ndtime, &r->lines, &r->numbers) == 3 &&
+         fgets(line, sizeof line, fp) &&
+         sscanf(line, "   total run  time %lf s  -  total files %d  -  PASSED %d  -  FAILED %d",
+                &runtime, &r->total, &passed, &r->failed) == 4 &&
+         r->total == passed + r->failed,
+         "old summary format in accumulation file %s not understood, run --reset", file);
+
+  *t0_ = (long long)mktime(&tm);
+  r->t = *t0_ + (long long)runtime;
+
+  debug("old summary format in accumulation file %s converted", file);
+  return 1;
+}
+
+// read records after the last reset (all records if history is set)
+static struct accum_rec*
+accum_read(const char *file, int history, long *n_, long long *t0_)
+{
+  FILE *fp = fopen(file, "r");
+  ensure(fp, "failed to read accumulation file %s", file);
 
-  FILE *fp;
-  if (!option.reset && (fp = fopen(option.accum, "r+"))) {
-    // read time stamps
-    n = fscanf(fp, " = tests summary (started at %d.%d.%d %d:%d:%d %d)\n",
-                   &tm.tm_year, &tm.tm_mon, &tm.tm_mday,
-                   &tm.tm_hour, &tm.tm_min, &tm.tm_sec, &tm.tm_isdst);
-    ensure(n == 7, "invalid summary file format %s", option.accum);
-    tm.tm_year -= 1900;
-    tm.tm_mon  -= 1;
-
-    // correct for TZ shift (i.e. emulate non-standard timegm)
-    struct tm tm2 = tm;
-    option.dat_t0 = mktime(&tm2);
-    tm2 = *gmtime(&now);
-    tz = difftime(now, mktime(&tm2));
-
-    // read diff time, line and number counts
-    n = fscanf(fp, "   total diff time %lf s  -  total lines %ld  -  total numbers %ld\n",
-                   &total_ndtime, &total_lines, &total_numbers);
-    ensure(n == 3, "invalid summary file format %s (lines)", option.accum);
-    // read tests counts
-    n = fscanf(fp, "   total run  time %*f s  -  total files %d - PASSED %d - FAILED %d\n",
-                   &total_tests, &total_passed, &total_failed);
-    ensure(n == 3, "invalid summary file format %s (files)", option.accum);
-    ensure(total_tests == total_passed+total_failed, "invalid summary count in file %s", option.accum);
-
-    // reset file
-    rewind(fp);
+#ifndef _WIN32
+  flock(fileno(fp), LOCK_SH);
+#endif
+
+  struct accum_rec *rec = 0;
+  long n = 0, max = 0;
+  long long t0 = -1;
+  char buf[FILENAME_MAX+128];
+
+  while (fgets(buf, sizeof buf, fp)) {
+    struct accum_rec r;
+    long long t;
+    int pos = 0;
+
+    if (sscanf(buf, "= reset %lld", &t) == 1) {
+      if (!history) {
+        for (long i = 0; i < n; i++) free(rec[i].name);
+        n = 0;
+      }
+      t0 = t;
+      continue;
+    }
+
+    if (accum_legacy(fp, file, buf, &r, &t)) {
+      if (!history) {
+        for (long i = 0; i < n; i++) free(rec[i].name);
+        n = 0;
+      }
+      t0 = t;
+      strcpy(buf, "+ (summary)");
+      pos = 2;
+    } else
+    if (sscanf(buf, "+ %lld %lf %lld %lld %d %d %n", &r.t, &r.ndtime, &r.lines, &r.numbers,
+                                                   &r.total, &r.failed, &pos) != 6 || !pos) {
+      warning("invalid record in accumulation file %s skipped", file);
+      continue;
+    }
+
+    buf[strcspn(buf, "\n")] = 0;
+
+    if (n == max) {
+      max = max ? 2*max : 64;
+      rec = realloc(rec, max * sizeof *rec);
+      ensure(rec, "out of memory");
+    }
+
+    r.idx  = n;
+    r.name = malloc(strlen(buf+pos)+1);
+    ensure(r.name, "out of memory");
+    strcpy(r.name, buf+pos);
+    rec[n++] = r;
   }
-  else {
-    // create the file
-    fp = fopen(option.accum, "w+");
-    ensure(fp, "failed to create or read summary file %s", option.accum);
-    option.reset = 0;
-
-    // init the time stamp
-    tm = *localtime(&option.dat_t0);
-    tz = 0;
+
+#ifndef _WIN32
+  flock(fileno(fp), LOCK_UN);
+#endif
+  fclose(fp);
+
+  // without reset, the summary starts at the first record
+  if (t0 < 0) t0 = n ? (long long)(rec[0].t - rec[0].ndtime) : (long long)time(0);
+
+  *n_ = n, *t0_ = t0;
+  return rec;
+}
+
+static void
+accum_freerecs(struct accum_rec *rec, long n)
+{
+  for (long i = 0; i < n; i++) free(rec[i].name);
+  free(rec);
+}
+
+static int
+accum_cmp(const void *a_, const void *b_)
+{
+  const struct accum_rec *a = a_, *b = b_;
+  int c = strcmp(a->name, b->name);
+  return c ? c : a->idx - b->idx;
+}
+
+void
+accum_summary(FILE *fp)
+{
+  if (!option.accum) return;
+
+  long n;
+  long long t0;
+  struct accum_rec *rec = accum_read(option.accum, 0, &n, &t0);
+
+  int total_tests=0, total_failed=0;
+  llong total_lines=0, total_numbers=0;
+  double total_ndtime=0;
+  long long t1 = t0;
+
+  for (long i = 0; i < n; i++) {
+    total_ndtime  += rec[i].ndtime;
+    total_lines   += rec[i].lines;
+    total_numbers += rec[i].numbers;
+    total_tests   += rec[i].total;
+    total_failed  += rec[i].failed;
+    if (t1 < rec[i].t) t1 = rec[i].t;
   }
 
-  double total_time = difftime(now, option.dat_t0) + tz - tm.tm_isdst*3600;
-  total_ndtime  += (option.clk_t1 - option.clk_t0) / CLOCKS_PER_SEC;
-  total_lines   += lines;
-  total_numbers += numbers;
+  time_t t = t0;
+  struct tm tm = *localtime(&t);
 
   fprintf(fp, " = tests summary (started at %04d.%02d.%02d %02d:%02d:%02d %+d)\n",
           tm.tm_year+1900, tm.tm_mon+1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec, tm.tm_isdst);
 
-  fprintf(fp, "   total diff time %6.2lf s  -  total lines %6ld  -  total numbers %8ld\n",
+  fprintf(fp, "   total diff time %6.2lf s  -  total lines %6lld  -  total numbers %8lld\n",
               total_ndtime, total_lines, total_numbers);
 
   fprintf(fp, "   total run  time %6.0f s  -  total files %6d  -  PASSED %4d  -  FAILED %4d\n",
-              total_time, total_tests+total, total_passed+(total-failed), total_failed+failed);
+              (double)(t1-t0), total_tests, total_tests-total_failed, total_failed);
 
-  fclose(fp);
+  accum_freerecs(rec, n);
+}
+
+void
+accum_history(FILE *fp)
+{
+  if (!option.accum) return;
+
+  long n;
+  long long t0;
+  struct accum_rec *rec = accum_read(option.accum, 1, &n, &t0);
+
+  // group by test, keep runs in log order
+  qsort(rec, n, sizeof *rec, accum_cmp);
+
+  for (long i = 0; i < n; i++) {
+    const struct accum_rec *r = rec+i;
+    bool first = !i || strcmp(rec[i-1].name, r->name);
+
+    if (first) fprintf(fp, " = %s\n", r->name);
+
+    time_t t = r->t;
+    struct tm tm = *localtime(&t);
+    double nps = r->ndtime > 0 ? r->numbers / r->ndtime : 0;
+
+    fprintf(fp, "   %04d.%02d.%02d %02d:%02d:%02d  %8.3f s  lines %8lld  numbers %10lld  %8.3g num/s",
+            tm.tm_year+1900, tm.tm_mon+1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec,
+            r->ndtime, r->lines, r->numbers, nps);
+
+    // trend versus the previous run of the same test
+    if (!first && nps > 0 && rec[i-1].ndtime > 0 && rec[i-1].numbers > 0)
+      fprintf(fp, "  (x%.2f)", nps / (rec[i-1].numbers / rec[i-1].ndtime));
+
+    fprintf(fp, "  %d/%d\n", r->total-r->failed, r->total);
+  }
+
+  accum_freerecs(rec, n);
+}
+
+static int
+accum_tcmp(const void *a_, const void *b_)
+{
+  const struct accum_rec *a = a_, *b = b_;
+  return a->t < b->t ? -1 : a->t > b->t ? 1 : a->idx - b->idx;
+}
+
+void
+accum_merge(const char *file[], int n)
+{
+  if (!option.accum || !n) return;
+
+  struct accum_rec *rec = 0;
+  long m = 0;
+  long long t0 = -1;
+
+  // records after the last reset of each shard
+  for (int i = 0; i < n; i++) {
+    long k;
+    long long t;
+    struct accum_rec *r = accum_read(file[i], 0, &k, &t);
+
+    rec = realloc(rec, (m+k+1) * sizeof *rec);
+    ensure(rec, "out of memory");
+    for (long j = 0; j < k; j++, m++)
+      rec[m] = r[j], rec[m].idx = m;
+    free(r);
+
+    if (t0 < 0 || t < t0) t0 = t;
+  }
+
+  // one suite starting with the earliest shard, records in time order
+  qsort(rec, m, sizeof *rec, accum_tcmp);
+
+  char buf[FILENAME_MAX+128];
+  int len = snprintf(buf, sizeof buf, "= reset %lld\n", t0);
+  accum_write(buf, len);
+
+  for (long i = 0; i < m; i++) {
+    len = accum_format(buf, sizeof buf, rec[i].t, rec[i].ndtime, rec[i].lines, rec[i].numbers,
+                       rec[i].total, rec[i].failed, rec[i].name);
+    accum_write(buf, len);
+  }
+
+  accum_freerecs(rec, m);
+}
+
+void
+accum_times(const char *file, void (*fun)(void*, const char *name, double ndtime, int total), void *ctx)
+{
+  assert(file);
+
+  long n;
+  long long t0;
+  struct accum_rec *rec = accum_read(file, 1, &n, &t0);
+
+  for (long i = 0; i < n; i++)
+    fun(ctx, rec[i].name, rec[i].ndtime, rec[i].total);
+
+  accum_freerecs(rec, n);
 }
 
 static const double pow10_tbl[2*99+1] = { 
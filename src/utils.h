@@ -38,8 +38,19 @@ extern const char* fail_str;
 
 FILE*  open_file(const char* str, FILE **res_fp, int *idx, const char *ext, int optext, int required);
 void  close_file(FILE *fp, int zip);
+double file_size(const char* str, const char *ext); // size of str[ext][.zip] (first found)
+bool  is_zipext (const char *ext);    // index of compression extension, 0 if none
 
-void  accum_summary(int total, int failed, long lines, long numbers);
+int   skipLineFast (FILE *fp, int *i_); // unlocked skipLine
+int   readLineFast (FILE *fp, char *buf, int n, int *i_); // unlocked readLine
+llong skipLinesBulk(FILE *fp, llong n, llong *s_); // lines skipped, stop at end of file
+
+void  accum_append (int total, int failed, llong lines, llong numbers);
+void  accum_reset  (void);
+void  accum_summary(FILE *fp);
+void  accum_history(FILE *fp);
+void  accum_merge  (const char *file[], int n);
+void  accum_times  (const char *file, void (*fun)(void*, const char *name, double ndtime, int total), void *ctx);
 
 // inline functions
 
@@ -108,16 +119,33 @@ skipSpace (FILE *fp, int *i_)
   return c; 
 }
 
+// unlocked getc where declared (POSIX, Windows), for the fast readers of utils.c
+#if defined(_WIN32)
+#define getcUnlocked(fp) _getc_nolock(fp)
+#elif defined(getc_unlocked) || defined(_DEFAULT_SOURCE) || \
+     (defined(_POSIX_C_SOURCE) && _POSIX_C_SOURCE >= 199506L)
+#define getcUnlocked(fp) getc_unlocked(fp)
+#else
+#define getcUnlocked(fp) getc(fp)
+#endif
+
+// readers shared by the locked (here) and unlocked (fast) variants, fast is folded
 static inline int
-skipLine (FILE *fp, int *i_)
+getc_tpl (FILE *fp, const bool fast)
+{
+  return fast ? getcUnlocked(fp) : getc(fp);
+}
+
+static inline int
+skipLine_tpl (FILE *fp, int *i_, const bool fast)
 {
   int c = 0, i = 0;
 
-  while ((c = getc(fp)) != EOF) {
-    if (c == '\n') break;                 // \n   : Unix, Linux, MacOSX
+  while ((c = getc_tpl(fp, fast)) != EOF) {
+    if (c == '\n') break;                   // \n   : Unix, Linux, MacOSX
     if (c == '\r') {
-      if ((c = getc(fp)) != '\n')         // \r\n : Windows
-        ungetc(c, fp);                    // \r   : Mac (old)
+      if ((c = getc_tpl(fp, fast)) != '\n') // \r\n : Windows
+        ungetc(c, fp);                      // \r   : Mac (old)
       c = '\n'; break;
     }
     i++;
@@ -129,21 +157,32 @@ skipLine (FILE *fp, int *i_)
 }
 
 static inline int
-readLine (FILE *fp, char *buf, int n, int *i_)
+readData_tpl (FILE *fp, char *buf, int n, int *i_, const bool fast)
 {
   int c = 0, i = 0;
 
-  while (i < n-1 && (c = getc(fp)) != EOF) {
-    if (c == '\n') break;                 // \n   : Unix, Linux, MacOSX
+  while (i < n-1 && (c = getc_tpl(fp, fast)) != EOF) {
+    if (c == '\n') break;                   // \n   : Unix, Linux, MacOSX
     if (c == '\r') {
-      if ((c = getc(fp)) != '\n')         // \r\n : Windows
-        ungetc(c, fp);                    // \r   : Mac (old)
+      if ((c = getc_tpl(fp, fast)) != '\n') // \r\n : Windows
+        ungetc(c, fp);                      // \r   : Mac (old)
       c = '\n'; break;
     }
     buf[i++] = c;
   }
   buf[i] = 0;
 
+  if (i_) *i_ += i;
+
+  return c;
+}
+
+static inline int
+readLine_tpl (FILE *fp, char *buf, int n, int *i_, const bool fast)
+{
+  int i = 0;
+  int c = readData_tpl(fp, buf, n, &i, fast);
+
   if (isComment(buf)) buf[i=0] = 0;
 
   if (i_) *i_ += i;
@@ -151,4 +190,22 @@ readLine (FILE *fp, char *buf, int n, int *i_)
   return c;
 }
 
+static inline int
+skipLine (FILE *fp, int *i_)
+{
+  return skipLine_tpl(fp, i_, false);
+}
+
+static inline int
+readData (FILE *fp, char *buf, int n, int *i_)
+{
+  return readData_tpl(fp, buf, n, i_, false);
+}
+
+static inline int
+readLine (FILE *fp, char *buf, int n, int *i_)
+{
+  return readLine_tpl(fp, buf, n, i_, false);
+}
+
 #endif
@@ -0,0 +1,204 @@
+/*
+ o---------------------------------------------------------------------o
+ |
+ | Ndiff
+ |
+ | Copyright (c) 2012+ laurent.deniau@cern.ch
+ | Gnu General Public License
+ |
+ o---------------------------------------------------------------------o
+
+   Purpose:
+     wait for a file to be rewritten (Linux inotify)
+     degrade to polling the file status elsewhere
+
+ o---------------------------------------------------------------------o
+*/
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/inotify.h>
+#endif
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#include "error.h"
+#include "watch.h"
+
+#define T struct watch
+
+// ----- constants
+
+// polling period and buffer size for copies
+enum { POLLMS = 250, COPYSIZ = 1 << 16 };
+
+// ----- types
+
+struct watch {
+  char   path[FILENAME_MAX];
+  char   dir [FILENAME_MAX];
+  const char *name;
+
+  // inotify (-1 when polling)
+  int    fd, wd;
+
+  // last status (polling)
+  time_t mtime;
+  long   size;
+};
+
+// ----- private
+
+static void
+watch_sleep (void)
+{
+#ifdef _WIN32
+  Sleep(POLLMS);
+#else
+  struct timespec ts = { 0, POLLMS * 1000000L };
+  nanosleep(&ts, 0);
+#endif
+}
+
+static int
+watch_stat (T *w, time_t *mtime, long *size)
+{
+  struct stat st;
+  if (stat(w->path, &st)) return 0;
+  *mtime = st.st_mtime, *size = st.st_size;
+  return 1;
+}
+
+// wait for a status change, then for a stable status (end of writing)
+static int
+watch_poll (T *w)
+{
+  time_t t; long s;
+
+  do watch_sleep();
+  while (!watch_stat(w, &t, &s) || (t == w->mtime && s == w->size));
+
+  do {
+    w->mtime = t, w->size = s;
+    watch_sleep();
+  } while (!watch_stat(w, &t, &s) || t != w->mtime || s != w->size);
+
+  return 1;
+}
+
+#ifdef __linux__
+
+static int
+watch_notify (T *w)
+{
+  char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+
+  while (1) {
+    ssize_t n = read(w->fd, buf, sizeof buf);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return 0;
+
+    for (char *p = buf; p < buf+n; ) {
+      const struct inotify_event *ev = (const void*)p;
+      if (ev->mask & IN_IGNORED) return 0; // directory removed
+      if (ev->len && !strcmp(ev->name, w->name)) return 1;
+      p += sizeof *ev + ev->len;
+    }
+  }
+}
+
+#endif
+
+// -----------------------------------------------------------------------------
+// ----- interface
+// -----------------------------------------------------------------------------
+
+T*
+watch_alloc (const char *filename)
+{
+  assert(filename);
+
+  T *w = malloc(sizeof *w);
+  ensure(w, "out of memory");
+
+  snprintf(w->path, sizeof w->path, "%s", filename);
+  snprintf(w->dir , sizeof w->dir , "%s", filename);
+
+  char *sep = strrchr(w->dir, '/');
+  if (sep) *sep = 0, w->name = w->path + (sep - w->dir) + 1;
+  else     strcpy(w->dir, "."), w->name = w->path;
+
+  w->fd = w->wd = -1;
+  if (!watch_stat(w, &w->mtime, &w->size)) w->mtime = 0, w->size = -1;
+
+#ifdef __linux__
+  // watch the directory to catch files replaced by rename
+  if ((w->fd = inotify_init()) >= 0 &&
+      (w->wd = inotify_add_watch(w->fd, w->dir, IN_CLOSE_WRITE | IN_MOVED_TO)) < 0) {
+    close(w->fd);
+    w->fd = -1;
+  }
+#endif
+
+  debug("watching '%s' (%s)", w->path, w->fd >= 0 ? "inotify" : "polling");
+
+  return w;
+}
+
+void
+watch_free (T *w)
+{
+  if (!w) return;
+
+#ifdef __linux__
+  if (w->fd >= 0) close(w->fd);
+#endif
+
+  free(w);
+}
+
+int
+watch_wait (T *w)
+{
+  assert(w);
+
+#ifdef __linux__
+  if (w->fd >= 0) return watch_notify(w);
+#endif
+
+  return watch_poll(w);
+}
+
+FILE*
+watch_load (FILE *fp)
+{
+  assert(fp);
+
+  FILE *tmp = tmpfile();
+  ensure(tmp, "unable to create temporary file");
+
+  char *buf = malloc(COPYSIZ);
+  ensure(buf, "out of memory");
+
+  size_t n;
+  while ((n = fread(buf, 1, COPYSIZ, fp)) > 0)
+    ensure(fwrite(buf, 1, n, tmp) == n, "unable to write temporary file");
+
+  free(buf);
+  rewind(tmp);
+
+  return tmp;
+}
+
+#undef T
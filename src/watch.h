@@ -0,0 +1,43 @@
+#ifndef WATCH_H
+#define WATCH_H
+
+/*
+ o---------------------------------------------------------------------o
+ |
+ | Ndiff
+ |
+ | Copyright (c) 2012+ laurent.deniau@cern.ch
+ | Gnu General Public License
+ |
+ o---------------------------------------------------------------------o
+
+   Purpose:
+     wait for a file to be rewritten (Linux inotify)
+     degrade to polling the file status elsewhere
+
+ o---------------------------------------------------------------------o
+*/
+
+#include <stdio.h>
+#include "types.h"
+
+// ----- types
+
+struct watch;
+
+// ----- interface
+
+#define T struct watch
+
+T*    watch_alloc (const char *filename);
+void  watch_free  (T*);
+
+// block until the file is closed after writing or replaced, return 0 on error
+int   watch_wait  (T*);
+
+// copy the remaining content of a stream into a rewindable temporary stream
+FILE* watch_load  (FILE*);
+
+#undef T
+
+#endif
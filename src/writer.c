@@ -0,0 +1,229 @@
+/*
+ o---------------------------------------------------------------------o
+ |
+ | Ndiff
+ |
+ | Copyright (c) 2012+ laurent.deniau@cern.ch
+ | Gnu General Public License
+ |
+ o---------------------------------------------------------------------o
+
+   Purpose:
+     append lines to large buffers of an output stream
+     write the filled buffers with writev on a background thread (POSIX)
+
+ o---------------------------------------------------------------------o
+*/
+
+#define _DEFAULT_SOURCE
+
+#include <stdlib.h>
+#include <assert.h>
+#include <errno.h>
+
+#ifndef _WIN32
+#include <limits.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/uio.h>
+#endif
+
+#include "error.h"
+#include "writer.h"
+
+#define T struct writer
+
+// ----- constants
+
+// ring of buffers: one filled by the diff, the others queued or being written
+enum { WRBUFSIZ = 1 << 20, WRBUF_N = 4 };
+
+// ----- types
+
+struct wbuf {
+  char  *buf;
+  size_t len, siz;
+};
+
+struct wr {
+  T       w;               // public part (first)
+  FILE   *fp;
+  struct wbuf ring[WRBUF_N];
+  ulong   head, tail;      // queued buffers [head, tail), filled buffer tail
+  int     err;             // errno of the failed write
+#ifndef _WIN32
+  int     fd, stop;
+  pthread_t       thr;
+  pthread_mutex_t mtx;
+  pthread_cond_t  cnd;
+#endif
+};
+
+// ----- private
+
+#ifndef _WIN32
+
+// write buffers [beg, beg+n) of the ring, resume after partial writes
+static int
+writer_writev (struct wr *w, ulong beg, int n)
+{
+  struct iovec iov[WRBUF_N];
+
+  for (int i = 0; i < n; i++) {
+    const struct wbuf *b = &w->ring[(beg+i) % WRBUF_N];
+    iov[i].iov_base = b->buf, iov[i].iov_len = b->len;
+  }
+
+  struct iovec *v = iov;
+  while (n > 0) {
+    ssize_t r = writev(w->fd, v, n);
+    if (r < 0 && errno == EINTR) continue;
+    if (r < 0) return errno;
+
+    while (n > 0 && (size_t)r >= v->iov_len) r -= v->iov_len, v++, n--;
+    if (n > 0) v->iov_base = (char*)v->iov_base + r, v->iov_len -= r;
+  }
+
+  return 0;
+}
+
+static void*
+writer_run (void *w_)
+{
+  struct wr *w = w_;
+
+  pthread_mutex_lock(&w->mtx);
+  while (1) {
+    while (w->head == w->tail && !w->stop)
+      pthread_cond_wait(&w->cnd, &w->mtx);
+    if (w->head == w->tail) break;
+
+    ulong beg = w->head;
+    int   n   = (int)(w->tail - w->head);
+    pthread_mutex_unlock(&w->mtx);
+
+    int err = w->err ? 0 : writer_writev(w, beg, n); // discard after an error
+
+    pthread_mutex_lock(&w->mtx);
+    if (err) w->err = err;
+    w->head += n;
+    pthread_cond_broadcast(&w->cnd);
+  }
+  pthread_mutex_unlock(&w->mtx);
+
+  return 0;
+}
+
+#endif
+
+// queue the filled buffer, return the next one to fill
+static struct wbuf*
+writer_queue (struct wr *w)
+{
+  w->ring[w->tail % WRBUF_N].len = w->w.pos;
+
+#ifndef _WIN32
+  pthread_mutex_lock(&w->mtx);
+  w->tail++;
+  pthread_cond_broadcast(&w->cnd);
+  while (w->tail - w->head >= WRBUF_N)
+    pthread_cond_wait(&w->cnd, &w->mtx);
+  int err = w->err;
+  pthread_mutex_unlock(&w->mtx);
+#else
+  struct wbuf *b = &w->ring[w->tail % WRBUF_N];
+  int err = fwrite(b->buf, 1, b->len, w->fp) != b->len ? errno : 0;
+  if (err) w->err = err;
+  w->tail++, w->head++;
+#endif
+
+  ensure(!err, "unable to write result file (%s)", strerror(err));
+
+  return &w->ring[w->tail % WRBUF_N];
+}
+
+// -----------------------------------------------------------------------------
+// ----- interface
+// -----------------------------------------------------------------------------
+
+T*
+writer_alloc (FILE *fp)
+{
+  assert(fp);
+
+  struct wr *w = calloc(1, sizeof *w);
+  ensure(w, "out of memory");
+
+  for (int i = 0; i < WRBUF_N; i++) {
+    w->ring[i].buf = malloc(WRBUFSIZ);
+    w->ring[i].siz = WRBUFSIZ;
+    ensure(w->ring[i].buf, "out of memory");
+  }
+
+  w->fp    = fp;
+  w->w.buf = w->ring[0].buf;
+  w->w.siz = w->ring[0].siz;
+
+  // previous writes through the stream come first
+  fflush(fp);
+
+#ifndef _WIN32
+  w->fd = fileno(fp);
+  pthread_mutex_init(&w->mtx, 0);
+  pthread_cond_init (&w->cnd, 0);
+  ensure(!pthread_create(&w->thr, 0, writer_run, w), "unable to create thread");
+#endif
+
+  return &w->w;
+}
+
+void
+writer_free (T *w_)
+{
+  if (!w_) return;
+
+  struct wr *w = (struct wr*)w_;
+
+  if (w->w.pos) writer_queue(w);
+
+#ifndef _WIN32
+  pthread_mutex_lock(&w->mtx);
+  w->stop = 1;
+  pthread_cond_broadcast(&w->cnd);
+  pthread_mutex_unlock(&w->mtx);
+
+  pthread_join(w->thr, 0);
+  pthread_cond_destroy (&w->cnd);
+  pthread_mutex_destroy(&w->mtx);
+
+  int err = w->err;
+  for (int i = 0; i < WRBUF_N; i++) free(w->ring[i].buf);
+  free(w);
+  ensure(!err, "unable to write result file (%s)", strerror(err));
+#else
+  fflush(w->fp);
+  for (int i = 0; i < WRBUF_N; i++) free(w->ring[i].buf);
+  free(w);
+#endif
+}
+
+void
+writer_flush (T *w_, size_t n)
+{
+  assert(w_);
+
+  struct wr *w = (struct wr*)w_;
+  struct wbuf *b = w->w.pos ? writer_queue(w) : &w->ring[w->tail % WRBUF_N];
+
+  // long line, enlarge the buffer
+  if (b->siz < n) {
+    free(b->buf);
+    b->buf = malloc(n);
+    b->siz = n;
+    ensure(b->buf, "out of memory");
+  }
+
+  w->w.buf = b->buf, w->w.siz = b->siz, w->w.pos = 0;
+}
+
+#undef T
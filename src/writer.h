@@ -0,0 +1,64 @@
+#ifndef WRITER_H
+#define WRITER_H
+
+/*
+ o---------------------------------------------------------------------o
+ |
+ | Ndiff
+ |
+ | Copyright (c) 2012+ laurent.deniau@cern.ch
+ | Gnu General Public License
+ |
+ o---------------------------------------------------------------------o
+
+   Purpose:
+     append lines to large buffers of an output stream
+     write the filled buffers with writev on a background thread (POSIX)
+
+ o---------------------------------------------------------------------o
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "types.h"
+
+// ----- types
+
+struct writer {
+  char  *buf;          // buffer being filled
+  size_t pos, siz;
+};
+
+// ----- interface
+
+#define T struct writer
+
+// take over the writes to the stream (flushed), the stream stays open
+T*   writer_alloc (FILE*);
+// write pending data and wait for completion
+void writer_free  (T*);
+
+// hand the full buffer to the background thread, reserve n bytes
+void writer_flush (T*, size_t n);
+
+static inline void
+writer_put (T *w, const char *str, size_t n)
+{
+  if (w->pos + n > w->siz) writer_flush(w, n);
+  memcpy(w->buf + w->pos, str, n);
+  w->pos += n;
+}
+
+static inline void
+writer_line (T *w, const char *str)
+{
+  size_t n = strlen(str);
+  if (w->pos + n+1 > w->siz) writer_flush(w, n+1);
+  memcpy(w->buf + w->pos, str, n);
+  w->buf[w->pos+n] = '\n';
+  w->pos += n+1;
+}
+
+#undef T
+
+#endif
@@ -0,0 +1,335 @@
+/*
+ o---------------------------------------------------------------------o
+ |
+ | Ndiff
+ |
+ | Copyright (c) 2012+ laurent.deniau@cern.ch
+ | Gnu General Public License
+ |
+ o---------------------------------------------------------------------o
+
+   Purpose:
+     cache of decompressed files shared by concurrent processes
+     entries keyed by path, size and mtime, filled once under file locks
+     evicted in least recently used order beyond a total size (POSIX only)
+
+ o---------------------------------------------------------------------o
+*/
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#endif
+
+#include "error.h"
+#include "zcache.h"
+
+// An entry of hash h is made of two files in the cache directory:
+//   h.lck  key of the entry (path, size, mtime, command), locked by the users:
+//          shared to open the text, exclusive to fill or evict it
+//   h.txt  decompressed text, filled into h.tmp and renamed once complete
+// The lock files are never removed, so all processes lock the same inode.
+
+// ----- constants
+
+enum { ZCACHE_MAXOPEN = 8 };
+
+// ----- types
+
+struct zmap {
+  FILE  *fp;
+  void  *addr;
+  size_t len;
+};
+
+struct zent {
+  char   name[32];
+  llong  size;
+  time_t atime;
+};
+
+// ----- locals
+
+static struct zmap zcache_map[ZCACHE_MAXOPEN];
+
+// ----- private
+
+#ifndef _WIN32
+
+static ullong
+zcache_hash (const char *str)
+{
+  ullong h = 0xcbf29ce484222325ULL; // FNV-1a
+
+  while (*str) h = (h ^ (unsigned char)*str++) * 0x100000001b3ULL;
+
+  return h;
+}
+
+// open the text of the entry if its key matches, -1 otherwise
+static int
+zcache_lookup (int lfd, const char *key, const char *txt)
+{
+  char buf[2*FILENAME_MAX+100];
+  size_t len = strlen(key);
+
+  if (pread(lfd, buf, sizeof buf, 0) != (ssize_t)len || memcmp(buf, key, len))
+    return -1;
+
+  return open(txt, O_RDONLY);
+}
+
+// decompress file into tmp, rename it to txt on success
+static bool
+zcache_fill (const char *cmd, const char *file, const char *tmp, const char *txt)
+{
+  char buf[65536];
+  char zbuf[2*(FILENAME_MAX+100)];
+  bool ok = true;
+  size_t n;
+
+  snprintf(zbuf, sizeof zbuf, "%s %s", cmd, file);
+  debug("zcache: decompressing '%s'", zbuf);
+
+  int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) return false;
+
+  FILE *in = popen(zbuf, "r");
+  if (!in) { close(fd); unlink(tmp); return false; }
+
+  while (ok && (n = fread(buf, 1, sizeof buf, in)) > 0)
+    for (char *p = buf; ok && n > 0; ) {
+      ssize_t r = write(fd, p, n);
+      if (r < 0 && errno == EINTR) continue;
+      if (r < 0) ok = false; else p += r, n -= r;
+    }
+
+  if (pclose(in)) ok = false;
+  if (close(fd))  ok = false;
+
+  if (!ok || rename(tmp, txt)) {
+    unlink(tmp);
+    return false;
+  }
+
+  return true;
+}
+
+static int
+zcache_cmp (const void *a_, const void *b_)
+{
+  const struct zent *a = a_, *b = b_;
+
+  if (a->atime != b->atime) return a->atime < b->atime ? -1 : 1;
+  return strcmp(a->name, b->name);
+}
+
+// remove the least recently used texts beyond max bytes, skip busy entries and keep
+static void
+zcache_evict (const char *dir, llong max, const char *keep)
+{
+  char path[FILENAME_MAX+100];
+  struct zent *ent = 0;
+  long ent_n = 0, ent_max = 0;
+  llong total = 0;
+  struct dirent *de;
+  struct stat st;
+
+  DIR *d = opendir(dir);
+  if (!d) return;
+
+  while ((de = readdir(d))) {
+    size_t len = strlen(de->d_name);
+    if (len < 4 || len >= sizeof ent->name || strcmp(de->d_name+len-4, ".txt")) continue;
+
+    snprintf(path, sizeof path, "%s/%s", dir, de->d_name);
+    if (stat(path, &st)) continue;
+
+    if (ent_n == ent_max) {
+      ent_max = ent_max ? 2*ent_max : 64;
+      ent = realloc(ent, ent_max * sizeof *ent);
+      ensure(ent, "out of memory");
+    }
+
+    strcpy(ent[ent_n].name, de->d_name);
+    ent[ent_n].size  = st.st_size;
+    ent[ent_n].atime = st.st_atime;
+    total += st.st_size, ent_n++;
+  }
+  closedir(d);
+
+  if (total > max) qsort(ent, ent_n, sizeof *ent, zcache_cmp);
+
+  for (long i = 0; i < ent_n && total > max; i++) {
+    if (!strcmp(ent[i].name, keep)) continue;
+
+    snprintf(path, sizeof path, "%s/%.*s.lck", dir, (int)strlen(ent[i].name)-4, ent[i].name);
+    int lfd = open(path, O_RDWR);
+    if (lfd < 0) continue;
+
+    if (!flock(lfd, LOCK_EX | LOCK_NB)) {
+      snprintf(path, sizeof path, "%s/%s", dir, ent[i].name);
+      if (!unlink(path)) {
+        debug("zcache: evicted '%s' (%lld bytes)", path, ent[i].size);
+        total -= ent[i].size;
+      }
+    }
+    close(lfd);
+  }
+
+  free(ent);
+}
+
+// map the text and wrap it into a stream
+static FILE*
+zcache_map_fd (int fd)
+{
+  struct zmap *m = 0;
+  struct stat st;
+
+  for (int i = 0; i < ZCACHE_MAXOPEN && !m; i++)
+    if (!zcache_map[i].fp) m = &zcache_map[i];
+
+  ensure(m, "too many cached files open");
+
+  // touch for the eviction order
+  futimens(fd, (struct timespec[2]) {{ .tv_nsec = UTIME_NOW }, { .tv_nsec = UTIME_OMIT }});
+
+  if (fstat(fd, &st)) { close(fd); return 0; }
+
+  m->addr = 0, m->len = st.st_size;
+
+  // empty text, nothing to map
+  if (!m->len) {
+    m->fp = fdopen(fd, "r");
+    if (!m->fp) close(fd);
+    return m->fp;
+  }
+
+  m->addr = mmap(0, m->len, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (m->addr == MAP_FAILED) return m->addr = 0, (FILE*)0;
+
+  m->fp = fmemopen(m->addr, m->len, "r");
+  if (!m->fp) munmap(m->addr, m->len), m->addr = 0;
+
+  return m->fp;
+}
+
+#endif
+
+// -----------------------------------------------------------------------------
+// ----- interface
+// -----------------------------------------------------------------------------
+
+#ifndef _WIN32
+
+FILE*
+zcache_open (const char *dir, llong max, const char *file, const char *cmd)
+{
+  char path[PATH_MAX];
+  char key[2*FILENAME_MAX+100];
+  char lck[FILENAME_MAX+100], txt[FILENAME_MAX+100], tmp[FILENAME_MAX+100];
+  struct stat st;
+
+  assert(dir && file && cmd);
+
+  if (stat(file, &st) || !realpath(file, path)) return 0;
+
+  if (mkdir(dir, 0777) && errno != EEXIST) {
+    warning("unable to create cache directory '%s', cache disabled", dir);
+    return 0;
+  }
+
+  snprintf(key, sizeof key, "%s\n%lld %lld.%09ld\n%s\n", path, (llong)st.st_size,
+           (llong)st.st_mtim.tv_sec, (long)st.st_mtim.tv_nsec, cmd);
+
+  ullong h = zcache_hash(key);
+  snprintf(lck, sizeof lck, "%s/%016llx.lck", dir, h);
+  snprintf(txt, sizeof txt, "%s/%016llx.txt", dir, h);
+  snprintf(tmp, sizeof tmp, "%s/%016llx.tmp", dir, h);
+
+  int lfd = open(lck, O_RDWR | O_CREAT, 0666);
+  if (lfd < 0) {
+    warning("unable to open cache entry '%s', cache disabled", lck);
+    return 0;
+  }
+
+  // hit: shared lock, concurrent readers
+  flock(lfd, LOCK_SH);
+  int fd = zcache_lookup(lfd, key, txt);
+  bool filled = false;
+
+  // miss: exclusive lock, the first process fills, the others wait and hit
+  if (fd < 0) {
+    flock(lfd, LOCK_EX);
+    fd = zcache_lookup(lfd, key, txt);
+
+    if (fd < 0 && zcache_fill(cmd, file, tmp, txt)) {
+      size_t len = strlen(key);
+      if (!ftruncate(lfd, 0) && pwrite(lfd, key, len, 0) == (ssize_t)len)
+        fd = open(txt, O_RDONLY), filled = true;
+      else
+        unlink(txt);
+    }
+  }
+
+  close(lfd); // unlock, the text stays readable if evicted
+
+  if (fd < 0) {
+    warning("unable to fill cache entry '%s', cache bypassed", txt);
+    return 0;
+  }
+
+  debug("zcache: %s '%s' for '%s'", filled ? "filled" : "hit", txt, file);
+
+  if (filled) zcache_evict(dir, max, strrchr(txt, '/')+1);
+
+  return zcache_map_fd(fd);
+}
+
+bool
+zcache_close (FILE *fp)
+{
+  for (int i = 0; i < ZCACHE_MAXOPEN; i++) {
+    struct zmap *m = &zcache_map[i];
+    if (fp && m->fp == fp) {
+      fclose(m->fp);
+      if (m->addr) munmap(m->addr, m->len);
+      *m = (struct zmap) { 0 };
+      return true;
+    }
+  }
+
+  return false;
+}
+
+#else
+
+FILE*
+zcache_open (const char *dir, llong max, const char *file, const char *cmd)
+{
+  (void)dir, (void)max, (void)file, (void)cmd;
+  return 0;
+}
+
+bool
+zcache_close (FILE *fp)
+{
+  (void)fp, (void)zcache_map;
+  return false;
+}
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef ZCACHE_H
+#define ZCACHE_H
+
+/*
+ o---------------------------------------------------------------------o
+ |
+ | Ndiff
+ |
+ | Copyright (c) 2012+ laurent.deniau@cern.ch
+ | Gnu General Public License
+ |
+ o---------------------------------------------------------------------o
+
+   Purpose:
+     cache of decompressed files shared by concurrent processes
+     entries keyed by path, size and mtime, filled once under file locks
+     evicted in least recently used order beyond a total size (POSIX only)
+
+ o---------------------------------------------------------------------o
+*/
+
+#include <stdio.h>
+#include "types.h"
+
+// ----- interface
+
+// open the decompressed text of file from the cache directory dir (bounded to max bytes),
+// decompress it with cmd on a miss, return null if the file cannot be cached
+FILE* zcache_open  (const char *dir, llong max, const char *file, const char *cmd);
+
+// close a stream returned by zcache_open, return false for other streams
+bool  zcache_close (FILE*);
+
+#endif